@@ -5,14 +5,20 @@
 #include "fs20.h"
 
 
-VulkanManager::VulkanManager(JavaVM* jvm, jobject globalActivityRef, ANativeWindow *window)
-        : mJvm(jvm), mActivity(globalActivityRef), mWindow(window), mInstance(VK_NULL_HANDLE) {}
+VulkanManager::VulkanManager(JavaVM* jvm, jobject globalActivityRef, ANativeWindow *window, const std::string& filesDir)
+        : mJvm(jvm), mActivity(globalActivityRef), mWindow(window), mInstance(VK_NULL_HANDLE), mFilesDir(filesDir) {}
 
 VulkanManager::~VulkanManager() {
     cleanup();
 }
 
 static VulkanManager *vkManager = nullptr;  // Global pointer to manage Vulkan lifecycle
+// The init thread's initVulkan()/attachSurface() and the UI thread's releaseSurface() and cleanup
+// run one at a time under surfaceMutex. surfaceGeneration counts surfaces handed over or released,
+// so an init thread that only gets the lock after its surface was released leaves it alone.
+static std::mutex surfaceMutex;
+static uint64_t surfaceGeneration = 0;
+static std::chrono::steady_clock::time_point libraryLoadTime;  // Origin for cold start timing
 
 // Callback function for Debug Messenger
 static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
@@ -26,7 +32,40 @@ static VKAPI_ATTR VkBool32 VKAPI_CALL debugCallback(
 }
 
 
+// Startup runs in three stages so pixels reach the screen before the expensive work is done:
+// the device, then the swapchain and a cleared first frame, then the simulation resources and
+// pipelines. The activity is told the simulation is ready, with the stage timings, at the end.
 int VulkanManager::initVulkan() {
+    auto elapsedMs = [](std::chrono::steady_clock::time_point since) {
+        return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - since).count();
+    };
+    auto initStart = std::chrono::steady_clock::now();
+
+    if (initDevice() != 0) {
+        return -1;
+    }
+    float deviceMs = elapsedMs(initStart);
+
+    if (initPresentation() != 0) {
+        return -1;
+    }
+    presentClearFrame();
+    float firstFrameMs = elapsedMs(initStart);
+    LOGI("First frame presented %.1f ms after init started, %.1f ms after library load",
+         firstFrameMs, elapsedMs(libraryLoadTime));
+
+    initSimulation();
+    float readyMs = elapsedMs(initStart);
+    LOGI("Startup: device %.1f ms, first frame %.1f ms, simulation ready %.1f ms", deviceMs, firstFrameMs, readyMs);
+
+    notifyClient(firstFrameMs, readyMs);
+    return 0;
+}
+
+// Stage 1: instance, surface, physical device selection and the logical device
+int VulkanManager::initDevice() {
+    mConfig = EngineConfig::load(mFilesDir + "/fs20.conf");
+
     VkApplicationInfo appInfo = {};
     appInfo.sType = VK_STRUCTURE_TYPE_APPLICATION_INFO;
     appInfo.pApplicationName = "VulkanManager";
@@ -83,6 +122,12 @@ int VulkanManager::initVulkan() {
      //   throw std::runtime_error("failed to set up debug messenger!");
     //}
 #endif
+    // Create the Android Surface first; queue family selection needs it for present support
+    if (createSurface() != VK_SUCCESS) {
+        std::cerr << "Failed to create Android surface!" << std::endl;
+        return -1;
+    }
+
     // Select Physical Device
 
     // Find all GPU with Vulkan support
@@ -103,41 +148,44 @@ int VulkanManager::initVulkan() {
     std::vector<const char*> requiredExtensions = {
             VK_KHR_SWAPCHAIN_EXTENSION_NAME,
             VK_KHR_DYNAMIC_RENDERING_EXTENSION_NAME,
-            VK_KHR_STORAGE_BUFFER_STORAGE_CLASS_EXTENSION_NAME
+            VK_KHR_STORAGE_BUFFER_STORAGE_CLASS_EXTENSION_NAME,
+            VK_KHR_TIMELINE_SEMAPHORE_EXTENSION_NAME
     };
 
-    VkPhysicalDevice selectedDevice = VK_NULL_HANDLE;
-
-    selectedDevice = pickSuitableDevice(devices, requiredExtensions);
-    if (selectedDevice == VK_NULL_HANDLE) {
-        // take the first one
-        if (deviceCount > 0) {
-            selectedDevice = devices[0];
-        } else {
-            throw std::runtime_error("failed to find a suitable GPU!");
-        }
+    // Everything later init needs to know about the GPU, queried once per device while picking one
+    DeviceProfile profile;
+    mPhysicalDevice = pickSuitableDevice(devices, requiredExtensions, profile);
+    if (mPhysicalDevice == VK_NULL_HANDLE) {
+        LOGE("No device has the required extensions and queue families, trying the first one");
+        mPhysicalDevice = devices[0];
+        profile = queryDeviceProfile(mPhysicalDevice);
     }
-
-    mPhysicalDevice = selectedDevice;
-    //checkDeviceExtensionSupport(mPhysicalDevice, requiredExtensions);
+    mDeviceProfile = std::make_unique<const DeviceProfile>(std::move(profile));
+    logDeviceProfile(*mDeviceProfile);
+    mKernels = &selectKernelPermutation();
 
     // create mDevice
     createLogicalDevice(requiredExtensions);
+    createPipelineCache();
+
+    // Leave a core for the init thread, which keeps creating resources while pipelines compile
+    unsigned workerCount = std::max(1u, std::min(4u, std::thread::hardware_concurrency() - 1));
+    mPipelineWorkers = std::make_unique<ThreadPool>(mConfig.getUint("pipeline_threads", workerCount));
+    return 0;
+}
 
-    // Create the Android Surface
+VkResult VulkanManager::createSurface() {
     VkAndroidSurfaceCreateInfoKHR surfaceCreateInfo = {};
     surfaceCreateInfo.sType = VK_STRUCTURE_TYPE_ANDROID_SURFACE_CREATE_INFO_KHR;
     surfaceCreateInfo.window = mWindow;  // ANativeWindow pointer obtained from Android environment.
+    return vkCreateAndroidSurfaceKHR(mInstance, &surfaceCreateInfo, nullptr, &mSurface);
+}
 
-    if (vkCreateAndroidSurfaceKHR(mInstance, &surfaceCreateInfo, nullptr,
-                                  &mSurface) != VK_SUCCESS) {
-        std::cerr << "Failed to create Android surface!" << std::endl;
-        return -1;
-    }
-
+// Stage 2: everything needed to put a frame on screen
+int VulkanManager::initPresentation() {
     // Check if the surface is supported by the physical device
     VkBool32 surfaceSupported = VK_FALSE;
-    result = vkGetPhysicalDeviceSurfaceSupportKHR(mPhysicalDevice, 0, mSurface, &surfaceSupported);
+    VkResult result = vkGetPhysicalDeviceSurfaceSupportKHR(mPhysicalDevice, 0, mSurface, &surfaceSupported);
     if (result != VK_SUCCESS || !surfaceSupported) {
         LOGE("Surface is not supported by the physical device: %d", result);
         return -1;
@@ -161,21 +209,118 @@ int VulkanManager::initVulkan() {
         throw std::runtime_error("failed to create Swap Chain!");
     }
 
-    createGraphicsPipeline();
+    createRenderPass();
+    createFramebuffers();
+    initSemaphores();
+    createFrameContexts();
+    createGraphicsCommandPool();
+    return 0;
+}
+
+// Stage 3: simulation buffers, descriptor sets and pipelines. The graphics pipeline and the
+// generic kernels compile on the worker pool while the buffers are created.
+void VulkanManager::initSimulation() {
     createPipelineLayout();
-    createComputePipeline();
+    createGraphicsPipeline();
+
+    // The grid starts out the size of the surface and follows it through resampleGrid(); the
+    // boundary is fixed for the run; workgroup shape and unroll are tuned below
+    mComputeSpecialization.gridWidth = mSwapChainExtent.width;
+    mComputeSpecialization.gridHeight = mSwapChainExtent.height;
+    mComputeSpecialization.boundaryMode = mConfig.getString("boundary", "zero") == "wrap" ?
+            ComputeSpecialization::BOUNDARY_WRAP : ComputeSpecialization::BOUNDARY_ZERO;
+
     createSharedTexture();
-    initVulkanFences();
-    initSynchronization();
-    initSemaphores();
-    initImagesInFlight();
-    createFramebuffers();
+    mGridCapacity = withGridHeadroom(static_cast<VkDeviceSize>(mSwapChainExtent.width) * mSwapChainExtent.height);
     createShaderBuffers();
+    mComputeSpecialization.quietPasses = static_cast<uint32_t>(mSimStates.size()) - 1;
+    createDescriptorPool();
+    createFieldStatsBuffer();
+    createUploadBuffer();
+    createTileBuffers(mComputeSpecialization);
+    setupComputeDescriptorSet();
+    setupGraphicsDescriptorSets();
+    setupReduceDescriptorSets();
+    setupTileCompactDescriptorSet();
+    createCommandBufferForCompute();
+    createProgressiveComputePipelines(mComputeSpecialization);
+
+    // Only needed once the surface changes, so it queues behind the kernels the first frames need
+    mResamplePipeline = submitPipelineBuild([this]() {
+        return createComputePipelineFromShader("resample", mResamplePipelineLayout);
+    });
+}
+
+// The window is going away (app backgrounded, activity recreated): drop everything tied to it but
+// keep the device, pipelines and simulation state, so attachSurface() can carry on where this left off.
+void VulkanManager::releaseSurface() {
+    stopRenderLoop();
+    if (mDevice != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(mDevice);
+        mDeletionQueue.flushAll();  // Retired swapchains must go before their surface
+    }
+    if (mSwapChain != VK_NULL_HANDLE) {
+        cleanupSwapChain();
+    }
+    if (mSurface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+        mSurface = VK_NULL_HANDLE;
+    }
+    if (mWindow != nullptr) {
+        ANativeWindow_release(mWindow);
+        mWindow = nullptr;
+    }
+    LOGI("Surface released, simulation kept");
+}
 
-    // Notify client that Vulkan is initialized
-    notifyClient();
+// Rebuilds the surface, swapchain and framebuffers on a new window and restarts the render loop.
+// activityRef replaces the activity to notify, which differs after a configuration change.
+void VulkanManager::attachSurface(ANativeWindow* window, jobject activityRef) {
+    auto start = std::chrono::steady_clock::now();
+    if (activityRef != mActivity) {
+        JNIEnv* env;
+        mJvm->AttachCurrentThread(&env, nullptr);
+        env->DeleteGlobalRef(mActivity);
+        mActivity = activityRef;
+    }
 
-    return 0;
+    mWindow = window;
+    if (createSurface() != VK_SUCCESS) {
+        throw std::runtime_error("failed to create Android surface!");
+    }
+    VkBool32 surfaceSupported = VK_FALSE;
+    vkGetPhysicalDeviceSurfaceSupportKHR(mPhysicalDevice, mDeviceProfile->queueFamilies.presentFamily.value(),
+                                         mSurface, &surfaceSupported);
+    if (!surfaceSupported) {
+        throw std::runtime_error("new surface is not supported by the device!");
+    }
+
+    VkFormat previousFormat = mSwapChainImageFormat;
+    VkExtent2D previousExtent = mSwapChainExtent;
+    VkSurfaceTransformFlagBitsKHR previousTransform = mSwapChainTransform;
+    createSwapChain();
+    if (mSwapChainImageFormat != previousFormat) {
+        // The graphics pipeline was built for the old render pass; the render loop is stopped
+        // and the device idle
+        destroyPipeline(mGraphicsPipeline);
+        vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+        createRenderPass();
+        createGraphicsPipeline();
+    }
+    createFramebuffers();
+    requestGridResize(previousExtent, previousTransform);
+    mFrameCommands.renderDirty = true;
+    {
+        // The new surface has nothing on it yet, so a field that settled before the release still
+        // needs drawing; the loop goes back to sleep once it reads back quiescent again
+        std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+        mSimIdle = false;
+    }
+
+    float attachMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    LOGI("Surface attached in %.1f ms", attachMs);
+    notifyClient(attachMs, attachMs);
+    startRenderLoop();
 }
 
 bool VulkanManager::checkDeviceExtensionSupport(VkPhysicalDevice device) {
@@ -275,65 +420,477 @@ bool VulkanManager::checkDeviceExtensionSupport(VkPhysicalDevice device,
     return requiredExtensionsSet.empty();  // Returns true if all required extensions are supported by the device
 }
 
+// Among the devices with the required extensions and queues, picks the one with the highest solver
+// throughput: a cached score if this device and driver were measured before, otherwise a short
+// micro-benchmark of the solver kernel. device=<index or name> in fs20.conf (or the FS20_DEVICE
+// environment variable) overrides the choice. Each candidate is profiled once; the pick's profile
+// is returned in `profile`.
 VkPhysicalDevice VulkanManager::pickSuitableDevice(const std::vector<VkPhysicalDevice>& devices,
-                                                   const std::vector<const char*>& requiredExtensions) {
+                                                   const std::vector<const char*>& requiredExtensions,
+                                                   DeviceProfile& profile) {
+    std::vector<VkPhysicalDevice> suitableDevices;
+    std::vector<DeviceProfile> profiles;
     for (const auto& device : devices) {
-        LOGI("Found a device");
-        if (checkDeviceExtensionSupport(device, requiredExtensions)) {
-            // Device supports all required extensions
-            return device;
+        if (!checkDeviceExtensionSupport(device, requiredExtensions)) {
+            continue;
+        }
+        DeviceProfile candidate = queryDeviceProfile(device);
+        if (candidate.queueFamilies.isComplete()) {
+            suitableDevices.push_back(device);
+            profiles.push_back(std::move(candidate));
         }
     }
 
-    return VK_NULL_HANDLE;
-    //throw std::runtime_error("failed to find a suitable GPU!");
-}
+    // Checked before anything else, so an override that can't be honored is reported even when
+    // there is nothing to choose between
+    const char* environmentOverride = std::getenv("FS20_DEVICE");
+    std::string forced = mConfig.getString("device", environmentOverride ? environmentOverride : "");
+    if (!forced.empty()) {
+        bool found = false;
+        for (size_t i = 0; i < devices.size(); ++i) {
+            VkPhysicalDeviceProperties properties;
+            vkGetPhysicalDeviceProperties(devices[i], &properties);
+            if (forced != std::to_string(i) && std::string(properties.deviceName).find(forced) == std::string::npos) {
+                continue;
+            }
+            auto suitable = std::find(suitableDevices.begin(), suitableDevices.end(), devices[i]);
+            if (suitable != suitableDevices.end()) {
+                LOGI("Using device %s (forced by config)", properties.deviceName);
+                profile = std::move(profiles[suitable - suitableDevices.begin()]);
+                return devices[i];
+            }
+            LOGE("Device %s (forced by config) lacks the required extensions or queues", properties.deviceName);
+            found = true;
+        }
+        if (!found) {
+            LOGE("Device '%s' (forced by config) not found", forced.c_str());
+        }
+        LOGE("Ignoring device=%s, selecting automatically", forced.c_str());
+    }
 
-// create the mDevice
-void VulkanManager::createLogicalDevice(const std::vector<const char*>& requiredExtensions) {
-    QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice, mSurface);
+    if (suitableDevices.empty()) {
+        return VK_NULL_HANDLE;
+    }
+    if (suitableDevices.size() == 1) {
+        profile = std::move(profiles.front());
+        return suitableDevices.front();
+    }
 
-    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-    std::set<uint32_t> uniqueQueueFamilies = {
-            indices.graphicsFamily.value(),
-            //indices.presentFamily.value()
-    };
+    TuningCache cache(mFilesDir + "/tuning.cache");
+    size_t best = 0;
+    uint32_t bestScore = 0;
+    for (size_t i = 0; i < suitableDevices.size(); ++i) {
+        const VkPhysicalDeviceProperties& properties = profiles[i].properties;
+        std::string key = "device-" + std::to_string(properties.vendorID) + "-" + std::to_string(properties.deviceID) +
+                          "-" + std::to_string(properties.driverVersion);
 
-    // Add compute family if it's separate from graphics family
-    if (indices.computeFamily.has_value() && indices.computeFamily != indices.graphicsFamily) {
-        uniqueQueueFamilies.insert(indices.computeFamily.value());
+        std::vector<uint32_t> cached;
+        uint32_t score;
+        if (cache.lookup(key, cached) && cached.size() == 1) {
+            score = cached[0];
+        } else {
+            score = benchmarkPhysicalDevice(suitableDevices[i], profiles[i]);
+            cache.store(key, {score});
+        }
+        LOGI("Device %s: %u Mcells/s", properties.deviceName, score);
+
+        if (score > bestScore) {
+            best = i;
+            bestScore = score;
+        }
     }
+    profile = std::move(profiles[best]);
+    return suitableDevices[best];
+}
+
+// Runs DEVICE_BENCHMARK_STEPS solver steps over a DEVICE_BENCHMARK_GRID square grid with every tile
+// active on a throwaway logical device, and returns the throughput in millions of cell updates per
+// second (0 if the device can't run the benchmark).
+uint32_t VulkanManager::benchmarkPhysicalDevice(VkPhysicalDevice physicalDevice, const DeviceProfile& profile) {
+    ComputeSpecialization specialization;
+    specialization.gridWidth = DEVICE_BENCHMARK_GRID;
+    specialization.gridHeight = DEVICE_BENCHMARK_GRID;
+    if (specialization.localSizeX * specialization.localSizeY > profile.properties.limits.maxComputeWorkGroupInvocations) {
+        specialization.localSizeX = 8;
+        specialization.localSizeY = 8;
+    }
+    const uint32_t cellCount = DEVICE_BENCHMARK_GRID * DEVICE_BENCHMARK_GRID;
+    const uint32_t tileCount = specialization.tileCount();
+    const uint32_t queueFamily = profile.queueFamilies.computeFamily.value();
 
     float queuePriority = 1.0f;
-    for (uint32_t queueFamily : uniqueQueueFamilies) {
+    VkDeviceQueueCreateInfo queueCreateInfo = {};
+    queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
+    queueCreateInfo.queueFamilyIndex = queueFamily;
+    queueCreateInfo.queueCount = 1;
+    queueCreateInfo.pQueuePriorities = &queuePriority;
+
+    VkDeviceCreateInfo deviceCreateInfo = {};
+    deviceCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    deviceCreateInfo.queueCreateInfoCount = 1;
+    deviceCreateInfo.pQueueCreateInfos = &queueCreateInfo;
+
+    VkDevice device;
+    if (vkCreateDevice(physicalDevice, &deviceCreateInfo, nullptr, &device) != VK_SUCCESS) {
+        LOGE("Benchmark: failed to create a device on %s", profile.properties.deviceName);
+        return 0;
+    }
+    VkQueue queue;
+    vkGetDeviceQueue(device, queueFamily, 0, &queue);
+
+    // Everything below is released together at the end
+    std::vector<VkBuffer> buffers;
+    std::vector<VkDeviceMemory> memories;
+    VkDescriptorSetLayout setLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout paramsSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkFence fence = VK_NULL_HANDLE;
+
+    uint32_t score = 0;
+    try {
+        auto makeBuffer = [&](VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
+            VkBufferCreateInfo bufferInfo{};
+            bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            bufferInfo.size = size;
+            bufferInfo.usage = usage;
+            bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            VkBuffer buffer;
+            if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+                throw std::runtime_error("failed to create benchmark buffer!");
+            }
+            buffers.push_back(buffer);
+
+            VkMemoryRequirements memRequirements;
+            vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+            VkMemoryAllocateInfo allocInfo{};
+            allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+            allocInfo.allocationSize = memRequirements.size;
+            allocInfo.memoryTypeIndex = findMemoryType(profile.memoryProperties, memRequirements.memoryTypeBits, properties);
+            VkDeviceMemory memory;
+            if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+                throw std::runtime_error("failed to allocate benchmark memory!");
+            }
+            memories.push_back(memory);
+            vkBindBufferMemory(device, buffer, memory, 0);
+            return buffer;
+        };
+
+        // Same bindings as the real solver: state in (0, 1), state out (2, 3), tile list (4), tile flags (5)
+        VkBufferUsageFlags stateUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        std::array<VkBuffer, 6> bindings = {
+                makeBuffer(cellCount * sizeof(float) * 2, stateUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+                makeBuffer(cellCount * sizeof(float), stateUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+                makeBuffer(cellCount * sizeof(float) * 2, stateUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+                makeBuffer(cellCount * sizeof(float), stateUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+                makeBuffer(tileCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT),
+                makeBuffer(tileCount * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT),
+        };
+        VkBuffer argsBuffer = makeBuffer(sizeof(VkDispatchIndirectCommand), VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                                         VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VkBuffer paramsBuffer = makeBuffer(sizeof(FrameParams), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                                           VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+        VkBuffer splatBuffer = makeBuffer(sizeof(glm::vec2), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                                          VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+
+        // Every tile is active
+        void* mapped;
+        vkMapMemory(device, memories[4], 0, VK_WHOLE_SIZE, 0, &mapped);
+        for (uint32_t tile = 0; tile < tileCount; ++tile) {
+            static_cast<uint32_t*>(mapped)[tile] = tile;
+        }
+        vkUnmapMemory(device, memories[4]);
+        vkMapMemory(device, memories[6], 0, VK_WHOLE_SIZE, 0, &mapped);
+        *static_cast<VkDispatchIndirectCommand*>(mapped) = {tileCount, 1, 1};
+        vkUnmapMemory(device, memories[6]);
+        vkMapMemory(device, memories[7], 0, VK_WHOLE_SIZE, 0, &mapped);
+        *static_cast<FrameParams*>(mapped) = {1.0f / 60.0f, 0.1f, 0u, 1u, 1.0f,
+                                              static_cast<int32_t>(specialization.gridWidth),
+                                              static_cast<int32_t>(specialization.gridHeight)};
+        vkUnmapMemory(device, memories[7]);
+        vkMapMemory(device, memories[8], 0, VK_WHOLE_SIZE, 0, &mapped);
+        *static_cast<glm::vec2*>(mapped) = glm::vec2(0.5f, 0.5f);  // One touch splat in the middle
+        vkUnmapMemory(device, memories[8]);
+
+        std::array<VkDescriptorSetLayoutBinding, 6> layoutBindings{};
+        for (uint32_t i = 0; i < layoutBindings.size(); ++i) {
+            layoutBindings[i].binding = i;
+            layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            layoutBindings[i].descriptorCount = 1;
+            layoutBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        }
+        VkDescriptorSetLayoutCreateInfo setLayoutInfo{};
+        setLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+        setLayoutInfo.bindingCount = static_cast<uint32_t>(layoutBindings.size());
+        setLayoutInfo.pBindings = layoutBindings.data();
+        vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &setLayout);
+
+        // The frame parameters (set 1, binding 0) and touch splats (set 1, binding 1)
+        std::array<VkDescriptorSetLayoutBinding, 2> paramsBindings{};
+        paramsBindings[0].binding = 0;
+        paramsBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        paramsBindings[0].descriptorCount = 1;
+        paramsBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        paramsBindings[1].binding = 1;
+        paramsBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        paramsBindings[1].descriptorCount = 1;
+        paramsBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+        setLayoutInfo.bindingCount = static_cast<uint32_t>(paramsBindings.size());
+        setLayoutInfo.pBindings = paramsBindings.data();
+        vkCreateDescriptorSetLayout(device, &setLayoutInfo, nullptr, &paramsSetLayout);
+
+        std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+                {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, static_cast<uint32_t>(bindings.size()) + 1},
+                {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+        }};
+        VkDescriptorPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        poolInfo.maxSets = 2;
+        poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+        poolInfo.pPoolSizes = poolSizes.data();
+        vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool);
+
+        std::array<VkDescriptorSetLayout, 2> setLayouts = {setLayout, paramsSetLayout};
+        VkDescriptorSetAllocateInfo setAllocInfo{};
+        setAllocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        setAllocInfo.descriptorPool = descriptorPool;
+        setAllocInfo.descriptorSetCount = static_cast<uint32_t>(setLayouts.size());
+        setAllocInfo.pSetLayouts = setLayouts.data();
+        std::array<VkDescriptorSet, 2> descriptorSets;
+        if (vkAllocateDescriptorSets(device, &setAllocInfo, descriptorSets.data()) != VK_SUCCESS) {
+            throw std::runtime_error("failed to allocate benchmark descriptor set!");
+        }
+
+        std::array<VkDescriptorBufferInfo, 8> bufferInfos{};
+        std::array<VkWriteDescriptorSet, 8> descriptorWrites{};
+        for (uint32_t i = 0; i < bindings.size(); ++i) {
+            bufferInfos[i] = {bindings[i], 0, VK_WHOLE_SIZE};
+            descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            descriptorWrites[i].dstSet = descriptorSets[0];
+            descriptorWrites[i].dstBinding = i;
+            descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            descriptorWrites[i].descriptorCount = 1;
+            descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+        }
+        bufferInfos[6] = {paramsBuffer, 0, sizeof(FrameParams)};
+        descriptorWrites[6].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[6].dstSet = descriptorSets[1];
+        descriptorWrites[6].dstBinding = 0;
+        descriptorWrites[6].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        descriptorWrites[6].descriptorCount = 1;
+        descriptorWrites[6].pBufferInfo = &bufferInfos[6];
+        bufferInfos[7] = {splatBuffer, 0, VK_WHOLE_SIZE};
+        descriptorWrites[7].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[7].dstSet = descriptorSets[1];
+        descriptorWrites[7].dstBinding = 1;
+        descriptorWrites[7].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[7].descriptorCount = 1;
+        descriptorWrites[7].pBufferInfo = &bufferInfos[7];
+        vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+
+        VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+        pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+        pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+        pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+        vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout);
+
+        // The baseline solver, which every device can run
+        const EmbeddedShader* shader = findEmbeddedShader("compute_shader");
+        VkShaderModuleCreateInfo moduleInfo{};
+        moduleInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+        moduleInfo.codeSize = shader->size;
+        moduleInfo.pCode = shader->code;
+        vkCreateShaderModule(device, &moduleInfo, nullptr, &shaderModule);
+
+        VkSpecializationInfo specializationInfo{};
+        specializationInfo.mapEntryCount = static_cast<uint32_t>(computeSpecializationMapEntries().size());
+        specializationInfo.pMapEntries = computeSpecializationMapEntries().data();
+        specializationInfo.dataSize = sizeof(ComputeSpecialization);
+        specializationInfo.pData = &specialization;
+
+        VkComputePipelineCreateInfo pipelineInfo{};
+        pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+        pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+        pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+        pipelineInfo.stage.module = shaderModule;
+        pipelineInfo.stage.pName = "main";
+        pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
+        pipelineInfo.layout = pipelineLayout;
+        if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create benchmark pipeline!");
+        }
+
+        VkCommandPoolCreateInfo commandPoolInfo{};
+        commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        commandPoolInfo.queueFamilyIndex = queueFamily;
+        vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool);
+
+        VkCommandBufferAllocateInfo commandBufferInfo{};
+        commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        commandBufferInfo.commandPool = commandPool;
+        commandBufferInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        commandBufferInfo.commandBufferCount = 1;
+        VkCommandBuffer commandBuffer;
+        vkAllocateCommandBuffers(device, &commandBufferInfo, &commandBuffer);
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        vkBeginCommandBuffer(commandBuffer, &beginInfo);
+        for (uint32_t i = 0; i < 4; ++i) {
+            vkCmdFillBuffer(commandBuffer, bindings[i], 0, VK_WHOLE_SIZE, 0);
+        }
+        VkMemoryBarrier barrier{};
+        barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                             0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+        uint32_t paramsOffset = 0;
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0,
+                                static_cast<uint32_t>(descriptorSets.size()), descriptorSets.data(), 1, &paramsOffset);
+        barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+        barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+        for (uint32_t step = 0; step < DEVICE_BENCHMARK_STEPS; ++step) {
+            vkCmdDispatchIndirect(commandBuffer, argsBuffer, 0);
+            vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                                 0, 1, &barrier, 0, nullptr, 0, nullptr);
+        }
+        vkEndCommandBuffer(commandBuffer);
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+        vkCreateFence(device, &fenceInfo, nullptr, &fence);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &commandBuffer;
+
+        // The first run warms up caches and clocks; the second is timed on the CPU, which works
+        // on queues without timestamp support and includes the submission cost the app also pays
+        double seconds = 0.0;
+        for (int run = 0; run < 2; ++run) {
+            auto start = std::chrono::steady_clock::now();
+            vkQueueSubmit(queue, 1, &submitInfo, fence);
+            vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
+            vkResetFences(device, 1, &fence);
+            seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        }
+        double cellUpdates = static_cast<double>(cellCount) * DEVICE_BENCHMARK_STEPS;
+        score = static_cast<uint32_t>(std::min(cellUpdates / std::max(seconds, 1e-6) / 1e6, 4e9));
+    } catch (const std::exception& e) {
+        LOGE("Benchmark failed on %s: %s", profile.properties.deviceName, e.what());
+    }
+
+    vkDeviceWaitIdle(device);
+    vkDestroyFence(device, fence, nullptr);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroyPipeline(device, pipeline, nullptr);
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+    vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+    vkDestroyDescriptorSetLayout(device, paramsSetLayout, nullptr);
+    for (auto buffer : buffers) {
+        vkDestroyBuffer(device, buffer, nullptr);
+    }
+    for (auto memory : memories) {
+        vkFreeMemory(device, memory, nullptr);
+    }
+    vkDestroyDevice(device, nullptr);
+    return score;
+}
+
+// create the mDevice
+void VulkanManager::createLogicalDevice(const std::vector<const char*>& requiredExtensions) {
+    const QueueFamilyIndices& indices = mDeviceProfile->queueFamilies;
+
+    // Queues needed per family: graphics/present, plus the solver's queue (see findQueueFamilies)
+    std::map<uint32_t, uint32_t> queueCounts;
+    queueCounts[indices.graphicsFamily.value()] = 1;
+    uint32_t& computeFamilyCount = queueCounts[indices.computeFamily.value()];
+    computeFamilyCount = std::max(computeFamilyCount, indices.computeQueueIndex + 1);
+
+    std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
+    const float queuePriorities[] = {1.0f, 1.0f};
+    for (const auto& [queueFamily, queueCount] : queueCounts) {
         VkDeviceQueueCreateInfo queueCreateInfo = {};
         queueCreateInfo.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
         queueCreateInfo.queueFamilyIndex = queueFamily;
-        queueCreateInfo.queueCount = 1;
-        queueCreateInfo.pQueuePriorities = &queuePriority;
+        queueCreateInfo.queueCount = queueCount;
+        queueCreateInfo.pQueuePriorities = queuePriorities;
         queueCreateInfos.push_back(queueCreateInfo);
     }
 
     VkPhysicalDeviceFeatures deviceFeatures = {};
 
+    // The fp16 kernel permutations do their arithmetic in half precision
+    VkPhysicalDeviceShaderFloat16Int8Features float16Int8Features = {};
+    float16Int8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES;
+    float16Int8Features.shaderFloat16 = VK_TRUE;
+
+    // Frame synchronization waits on timeline values rather than fences
+    VkPhysicalDeviceTimelineSemaphoreFeatures timelineFeatures = {};
+    timelineFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_TIMELINE_SEMAPHORE_FEATURES;
+    timelineFeatures.pNext = mKernels->needsFloat16 ? &float16Int8Features : nullptr;
+    timelineFeatures.timelineSemaphore = VK_TRUE;
+
+    // The single-submit frame records its barriers and submit with synchronization2
+    mSingleSubmit = mConfig.getBool("single_submit", false);
+    if (mSingleSubmit && (!mDeviceProfile->synchronization2 || indices.asyncCompute())) {
+        LOGI("single_submit needs synchronization2 and a shared solver queue; using separate submits");
+        mSingleSubmit = false;
+    }
+    std::vector<const char*> extensions = requiredExtensions;
+    VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features = {};
+    synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+    synchronization2Features.pNext = &timelineFeatures;
+    synchronization2Features.synchronization2 = VK_TRUE;
+    if (mSingleSubmit) {
+        extensions.push_back(VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME);
+    }
+
     VkDeviceCreateInfo createInfo = {};
     createInfo.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
+    createInfo.pNext = mSingleSubmit ? static_cast<void*>(&synchronization2Features) : &timelineFeatures;
     createInfo.pQueueCreateInfos = queueCreateInfos.data();
     createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
     createInfo.pEnabledFeatures = &deviceFeatures;
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(requiredExtensions.size());
-    createInfo.ppEnabledExtensionNames = requiredExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(extensions.size());
+    createInfo.ppEnabledExtensionNames = extensions.data();
 
     if (vkCreateDevice(mPhysicalDevice, &createInfo, nullptr, &mDevice) != VK_SUCCESS) {
         throw std::runtime_error("failed to create logical device!");
     }
     LOGI("Logical device created successfully.");
+
+    // Through the extension: the device may only be Vulkan 1.1, where the core name isn't exported
+    mWaitSemaphores = (PFN_vkWaitSemaphoresKHR) vkGetDeviceProcAddr(mDevice, "vkWaitSemaphoresKHR");
+    if (!mWaitSemaphores) {
+        throw std::runtime_error("Could not load the vkWaitSemaphoresKHR function.");
+    }
+    if (mSingleSubmit) {
+        mQueueSubmit2 = (PFN_vkQueueSubmit2KHR) vkGetDeviceProcAddr(mDevice, "vkQueueSubmit2KHR");
+        mCmdPipelineBarrier2 = (PFN_vkCmdPipelineBarrier2KHR) vkGetDeviceProcAddr(mDevice, "vkCmdPipelineBarrier2KHR");
+        if (!mQueueSubmit2 || !mCmdPipelineBarrier2) {
+            throw std::runtime_error("Could not load the synchronization2 functions.");
+        }
+    }
     checkDeviceProperties(mPhysicalDevice, mSurface);
 
 
     // Retrieve queues from the device
     // Note: We only have one queue for Android, it has both compute and graphics, but no presentation queue
     vkGetDeviceQueue(mDevice, indices.graphicsFamily.value(), 0, &mGraphicsQueue);
+    vkGetDeviceQueue(mDevice, indices.computeFamily.value(), indices.computeQueueIndex, &mComputeQueue);
+    LOGI("Solver queue: family %u, index %u (%s)%s", indices.computeFamily.value(), indices.computeQueueIndex,
+         indices.asyncCompute() ? "async" : "shared with graphics", mSingleSubmit ? ", single submit per frame" : "");
     //if (indices.presentFamily.value() == indices.graphicsFamily.value()) {
         mPresentQueue = mGraphicsQueue;  // Same queue for graphics and presentation
     //} else {
@@ -394,11 +951,8 @@ VkSurfaceFormatKHR VulkanManager::chooseSwapSurfaceFormat(const std::vector<VkSu
 }
 
 VkPresentModeKHR VulkanManager::chooseSwapPresentMode(const std::vector<VkPresentModeKHR>& availablePresentModes) {
-    for (const auto& availablePresentMode : availablePresentModes) {
-        if (availablePresentMode == VK_PRESENT_MODE_MAILBOX_KHR) {
-            return availablePresentMode;
-        }
-    }
+    // The native render loop never sleeps; it is paced by acquire/present blocking at vsync.
+    // MAILBOX never blocks, so it would let the loop spin as fast as the GPU drains frames.
     return VK_PRESENT_MODE_FIFO_KHR;  // Guaranteed to be available
 }
 
@@ -470,7 +1024,7 @@ void VulkanManager::createSwapChain() {
     createInfo.imageArrayLayers = 1;
     createInfo.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
 
-    QueueFamilyIndices indices = findQueueFamilies(mPhysicalDevice, mSurface);
+    const QueueFamilyIndices& indices = mDeviceProfile->queueFamilies;
     uint32_t queueFamilyIndices[] = {indices.graphicsFamily.value()/*, indices.presentFamily.value()*/};
 
     /*if (indices.graphicsFamily != indices.presentFamily) {
@@ -485,16 +1039,27 @@ void VulkanManager::createSwapChain() {
     createInfo.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     createInfo.presentMode = presentMode;
     createInfo.clipped = VK_TRUE;
-    createInfo.oldSwapchain = VK_NULL_HANDLE;
+    // On a resize the old swapchain hands over to the new one, which lets the presentation engine
+    // reuse its resources; it is destroyed once the last frame presented from it is done
+    VkSwapchainKHR oldSwapChain = mSwapChain;
+    createInfo.oldSwapchain = oldSwapChain;
 
     if (vkCreateSwapchainKHR(mDevice, &createInfo, nullptr, &mSwapChain) != VK_SUCCESS) {
         throw std::runtime_error("failed to create swap chain!");
     }
+    if (oldSwapChain != VK_NULL_HANDLE) {
+        mDeletionQueue.push(mFrameValue, [this, oldSwapChain]() {
+            vkDestroySwapchainKHR(mDevice, oldSwapChain, nullptr);
+        });
+    }
 
     // Retrieve the swap chain images
     vkGetSwapchainImagesKHR(mDevice, mSwapChain, &imageCount, nullptr);
     mSwapChainImages.resize(imageCount);
+    mSwapChainImageCount = imageCount;
     vkGetSwapchainImagesKHR(mDevice, mSwapChain, &mSwapChainImageCount, mSwapChainImages.data());
+    // No frame has rendered into the new images yet
+    mImagePresentValues.assign(mSwapChainImageCount, 0);
     // After retrieving images from the swapchain
     for (auto image : mSwapChainImages) {
         if (image == VK_NULL_HANDLE) {
@@ -503,6 +1068,7 @@ void VulkanManager::createSwapChain() {
     }
     mSwapChainImageFormat = surfaceFormat.format;
     mSwapChainExtent = extent;
+    mSwapChainTransform = swapChainSupport.capabilities.currentTransform;
 
     mSwapChainImageViews.resize(imageCount);
 
@@ -543,24 +1109,36 @@ void VulkanManager::cleanupSwapChain() {
 
     vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
     mSwapChain = VK_NULL_HANDLE;
+}
 
-    // Also destroy and recreate graphics pipelines if they are dependent on the swapchain size
-    vkDestroyPipeline(mDevice, mGraphicsPipeline, nullptr);
-    mGraphicsPipeline = VK_NULL_HANDLE;
+// Hands the framebuffers and image views of the current swapchain to the deletion queue, to be
+// destroyed once the last frame submitted has finished with them. The swapchain itself is
+// retired by createSwapChain(), which passes it on as oldSwapchain.
+void VulkanManager::retireSwapChain() {
+    mDeletionQueue.push(mFrameValue, [this, framebuffers = mFramebuffers, imageViews = mSwapChainImageViews]() {
+        for (auto framebuffer : framebuffers) {
+            vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+        }
+        for (auto imageView : imageViews) {
+            vkDestroyImageView(mDevice, imageView, nullptr);
+        }
+    });
+    mFramebuffers.clear();
+    mSwapChainImageViews.clear();
 }
 
+// Resize or rotation: builds the new swapchain without waiting for the GPU. Frames in flight keep
+// rendering to and presenting the old one, which goes on the deletion queue with everything built
+// on it. The graphics pipeline takes its viewport from the command buffer, so it is kept; the
+// grid follows once drawFrame() has resampled it.
 void VulkanManager::recreateSwapChain() {
-    vkDeviceWaitIdle(mDevice);
-
-    cleanupSwapChain();  // Function to destroy old swapchain and related resources
-
-    createSwapChain();  // Recreate swapchain
-
-    createFramebuffers();  // Recreate framebuffers if necessary
-
-    // If your pipelines or other resources depend on the swapchain size, recreate them as well
-    createGraphicsPipeline();  // Only if necessary
-    // Update any necessary descriptors or buffers that depend on the swapchain size
+    VkExtent2D previousExtent = mSwapChainExtent;
+    VkSurfaceTransformFlagBitsKHR previousTransform = mSwapChainTransform;
+    retireSwapChain();
+    createSwapChain();
+    createFramebuffers();
+    requestGridResize(previousExtent, previousTransform);
+    mFrameCommands.renderDirty = true;
 }
 
 /*createInfo.imageFormat and createInfo.imageColorSpace: The combination of image format and color space might not be supported by the Vulkan driver or hardware. You can check the supported combinations by calling vkGetPhysicalDeviceSurfaceFormatsKHR.
@@ -665,6 +1243,8 @@ std::string VulkanManager::decodeUsageFlags(VkImageUsageFlags flags) {
 
 
 
+// Quiet, since device selection calls it for every device; logDeviceProfile() reports the
+// families of the device picked
 VulkanManager::QueueFamilyIndices VulkanManager::findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface) {
     QueueFamilyIndices indices;
 
@@ -673,27 +1253,24 @@ VulkanManager::QueueFamilyIndices VulkanManager::findQueueFamilies(VkPhysicalDev
     std::vector<VkQueueFamilyProperties> queueFamilies(queueFamilyCount);
     vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
-    LOGI("Checking %d queue families.", queueFamilyCount);
-
-    int i = 0;
+    std::optional<uint32_t> dedicatedComputeFamily;
+    uint32_t i = 0;
     for (const auto& queueFamily : queueFamilies) {
-        LOGI("Queue Family #%d: Flags=0x%X", i, queueFamily.queueFlags);
+        if ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) && !(queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) &&
+            !dedicatedComputeFamily.has_value()) {
+            dedicatedComputeFamily = i;
+        }
 
-        if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
+        if ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) && !indices.graphicsFamily.has_value()) {
             indices.graphicsFamily = i;
-            LOGI("Graphics queue found at index %d.", i);
-
             if (queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) {
                 indices.computeFamily = i;
-                LOGI("Compute queue found at index %d.", i);
             }
             if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) {
                 indices.transferFamily = i;
-                LOGI("Transfer queue found at index %d.", i);
             }
             if (queueFamily.queueFlags & VK_QUEUE_SPARSE_BINDING_BIT) {
                 indices.sparseBindingFamily = i;
-                LOGI("Sparse binding queue found at index %d.", i);
             }
         }
 
@@ -701,109 +1278,152 @@ VulkanManager::QueueFamilyIndices VulkanManager::findQueueFamilies(VkPhysicalDev
         vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
         if (presentSupport) {
             indices.presentFamily = i;
-            LOGI("Present queue found at index %d.", i);
         }
 
         i++;
     }
 
-    if (!indices.isComplete()) {
-        LOGI("Not all required queue families were found.");
+    // The solver gets its own queue where possible so it can run alongside rendering: a
+    // compute-only family first, then a second queue in the graphics family, else the graphics
+    // queue itself. async_compute=0 in fs20.conf forces the latter, as does single_submit=1,
+    // which puts the whole frame on the graphics queue.
+    if (mConfig.getBool("async_compute", true) && !mConfig.getBool("single_submit", false) &&
+        indices.graphicsFamily.has_value()) {
+        if (dedicatedComputeFamily.has_value()) {
+            indices.computeFamily = dedicatedComputeFamily;
+        } else if (indices.computeFamily == indices.graphicsFamily &&
+                   queueFamilies[indices.graphicsFamily.value()].queueCount > 1) {
+            indices.computeQueueIndex = 1;
+        }
     }
 
     return indices;
 }
 
+VulkanManager::DeviceProfile VulkanManager::queryDeviceProfile(VkPhysicalDevice device) {
+    DeviceProfile profile;
+    vkGetPhysicalDeviceProperties(device, &profile.properties);
+    vkGetPhysicalDeviceMemoryProperties(device, &profile.memoryProperties);
+    profile.queueFamilies = findQueueFamilies(device, mSurface);
 
-void VulkanManager::createGraphicsPipeline() {
-    // Assuming shaders are precompiled to SPIR-V and stored as .spv files in cmake
-    auto vertShaderCode = readFile("shaders/vertex_shader.spv");
-    auto fragShaderCode = readFile("shaders/fragment_shader.spv");
-
-    VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
-    VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
-
-    // Define shader stage create info for vertex and fragment shaders
-    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
-    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
-    vertShaderStageInfo.module = vertShaderModule;
-    vertShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
-    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    fragShaderStageInfo.module = fragShaderModule;
-    fragShaderStageInfo.pName = "main";
-
-    VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
-
-    // Define the pipeline's fixed-function stages (e.g., input assembly, viewport, rasterization)
-    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
-    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
-    std::vector<VkVertexInputBindingDescription> bindingDescriptions = Vertex::getBindingDescriptions();
-    std::vector<VkVertexInputAttributeDescription> attributeDescriptions = Vertex::getAttributeDescriptions();
-    vertexInputInfo.vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size());
-    vertexInputInfo.pVertexBindingDescriptions = bindingDescriptions.data();
-    vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-    vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
-
-    // Configure input assembly based on your application's needs
-    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
-    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
-    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
-    inputAssembly.primitiveRestartEnable = VK_FALSE;
-
-    // Viewport and scissor rectangle
-    VkViewport viewport = {};
-    viewport.x = 0.0f;
-    viewport.y = 0.0f;
-    viewport.width = static_cast<float>(mSwapChainExtent.width);
-    viewport.height = static_cast<float>(mSwapChainExtent.height);
-    viewport.minDepth = 0.0f;
-    viewport.maxDepth = 1.0f;
-
-    VkRect2D scissor = {};
-    scissor.offset = {0, 0};
-    scissor.extent = mSwapChainExtent;
-
-    VkPipelineViewportStateCreateInfo viewportState = {};
-    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
-    viewportState.viewportCount = 1;
-    viewportState.pViewports = &viewport;
-    viewportState.scissorCount = 1;
-    viewportState.pScissors = &scissor;
-
-    // Further configuration for pipeline creation (omitted)
-    VkDescriptorSetLayoutBinding uboLayoutBinding{};
-    uboLayoutBinding.binding = 0;
-    uboLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-    uboLayoutBinding.descriptorCount = 1;
-    uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
-    uboLayoutBinding.pImmutableSamplers = nullptr; // Optional
+    uint32_t queueFamilyCount = 0;
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, nullptr);
+    profile.queueFamilyProperties.resize(queueFamilyCount);
+    vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, profile.queueFamilyProperties.data());
+
+    // Subgroup properties are core since Vulkan 1.1, fp16/int8 arithmetic since 1.2
+    if (profile.properties.apiVersion >= VK_API_VERSION_1_1) {
+        VkPhysicalDeviceSubgroupProperties subgroupProperties{};
+        subgroupProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SUBGROUP_PROPERTIES;
+        VkPhysicalDeviceProperties2 properties2{};
+        properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+        properties2.pNext = &subgroupProperties;
+        vkGetPhysicalDeviceProperties2(device, &properties2);
+
+        profile.subgroupSize = subgroupProperties.subgroupSize;
+        profile.subgroupStages = subgroupProperties.supportedStages;
+        profile.subgroupOperations = subgroupProperties.supportedOperations;
+    }
+    if (profile.properties.apiVersion >= VK_API_VERSION_1_2) {
+        VkPhysicalDeviceShaderFloat16Int8Features float16Int8Features{};
+        float16Int8Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SHADER_FLOAT16_INT8_FEATURES;
+        VkPhysicalDeviceFeatures2 features2{};
+        features2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+        features2.pNext = &float16Int8Features;
+        vkGetPhysicalDeviceFeatures2(device, &features2);
+
+        profile.shaderFloat16 = float16Int8Features.shaderFloat16 == VK_TRUE;
+        profile.shaderInt8 = float16Int8Features.shaderInt8 == VK_TRUE;
+
+        if (checkDeviceExtensionSupport(device, {VK_KHR_SYNCHRONIZATION_2_EXTENSION_NAME})) {
+            VkPhysicalDeviceSynchronization2FeaturesKHR synchronization2Features{};
+            synchronization2Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_SYNCHRONIZATION_2_FEATURES_KHR;
+            features2.pNext = &synchronization2Features;
+            vkGetPhysicalDeviceFeatures2(device, &features2);
+            profile.synchronization2 = synchronization2Features.synchronization2 == VK_TRUE;
+        }
+    }
 
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 1;
-    layoutInfo.pBindings = &uboLayoutBinding;
+    return profile;
+}
 
-    VkDescriptorSetLayout descriptorSetLayout;
-    vkCreateDescriptorSetLayout(mDevice, &layoutInfo, nullptr, &descriptorSetLayout);
+void VulkanManager::logDeviceProfile(const DeviceProfile& profile) {
+    const VkPhysicalDeviceProperties& properties = profile.properties;
+    LOGI("Device: %s (vendor 0x%X, device 0x%X, driver 0x%X, API %u.%u.%u)", properties.deviceName,
+         properties.vendorID, properties.deviceID, properties.driverVersion, VK_VERSION_MAJOR(properties.apiVersion),
+         VK_VERSION_MINOR(properties.apiVersion), VK_VERSION_PATCH(properties.apiVersion));
+    LOGI("Subgroups: size %u, stages 0x%X, operations 0x%X", profile.subgroupSize, profile.subgroupStages,
+         profile.subgroupOperations);
+    LOGI("fp16 arithmetic: %s, int8 arithmetic: %s", profile.shaderFloat16 ? "yes" : "no", profile.shaderInt8 ? "yes" : "no");
+    LOGI("synchronization2: %s", profile.synchronization2 ? "yes" : "no");
+    LOGI("Compute shared memory: %u bytes, max invocations: %u", properties.limits.maxComputeSharedMemorySize,
+         properties.limits.maxComputeWorkGroupInvocations);
+    LOGI("Timestamps: period %f ns, %u valid bits on the compute queue", properties.limits.timestampPeriod,
+         profile.computeTimestampValidBits());
+    for (uint32_t i = 0; i < profile.memoryProperties.memoryHeapCount; ++i) {
+        const VkMemoryHeap& heap = profile.memoryProperties.memoryHeaps[i];
+        LOGI("Memory heap #%u: %llu MB%s", i, static_cast<unsigned long long>(heap.size >> 20),
+             (heap.flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) ? ", device local" : "");
+    }
+    for (uint32_t i = 0; i < profile.queueFamilyProperties.size(); ++i) {
+        const VkQueueFamilyProperties& family = profile.queueFamilyProperties[i];
+        LOGI("Queue family #%u: flags 0x%X, %u queues", i, family.queueFlags, family.queueCount);
+    }
+    const QueueFamilyIndices& families = profile.queueFamilies;
+    if (families.isComplete()) {
+        LOGI("Graphics queue family %u, present queue family %u", families.graphicsFamily.value(),
+             families.presentFamily.value());
+    } else {
+        LOGE("Not all required queue families were found.");
+    }
+}
 
+// Fastest first; selectKernelPermutation() takes the first one the device supports. The shaders are
+// the same sources compiled with different defines (see CMakeLists.txt), so there is no runtime
+// branching on capabilities inside the kernels.
+static const VulkanManager::KernelPermutation kernelPermutations[] = {
+        // name                    solver                        reduction                subgroup fp16   sharedTile
+        {"shared_fp16_subgroup", "compute_shader_shared_fp16", "field_reduce_subgroup", true,  true,  true},
+        {"shared_subgroup",      "compute_shader_shared",      "field_reduce_subgroup", true,  false, true},
+        {"shared_fp16",          "compute_shader_shared_fp16", "field_reduce",          false, true,  true},
+        {"shared",               "compute_shader_shared",      "field_reduce",          false, false, true},
+        {"baseline",             "compute_shader",             "field_reduce",          false, false, false},
+};
+
+bool VulkanManager::supportsKernelPermutation(const KernelPermutation& permutation) const {
+    const DeviceProfile& profile = *mDeviceProfile;
+    // The subgroup reduction finishes in a single subgroup, so it needs at least 256 / 16 lanes
+    bool subgroupReduce = (profile.subgroupStages & VK_SHADER_STAGE_COMPUTE_BIT) &&
+                          (profile.subgroupOperations & VK_SUBGROUP_FEATURE_ARITHMETIC_BIT) &&
+                          profile.subgroupSize >= 16;
+    return (!permutation.needsSubgroupReduce || subgroupReduce) && (!permutation.needsFloat16 || profile.shaderFloat16);
+}
 
-    // Now create the pipeline layout that uses this descriptor set layout
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1; // Optional
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout; // Optional
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional
-    pipelineLayoutInfo.pPushConstantRanges = nullptr; // Optional
+// kernels=<name> in fs20.conf forces a permutation, if the device supports it
+const VulkanManager::KernelPermutation& VulkanManager::selectKernelPermutation() {
+    std::string forced = mConfig.getString("kernels", "");
+    for (const auto& permutation : kernelPermutations) {
+        if (forced == permutation.name && supportsKernelPermutation(permutation)) {
+            LOGI("Using %s kernels (forced by config)", permutation.name);
+            return permutation;
+        }
+    }
+    if (!forced.empty()) {
+        LOGE("Kernel permutation '%s' is unknown or unsupported, selecting automatically", forced.c_str());
+    }
 
-    VkPipelineLayout pipelineLayout;
-    if (vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create pipeline layout!");
+    for (const auto& permutation : kernelPermutations) {
+        if (supportsKernelPermutation(permutation)) {
+            LOGI("Using %s kernels", permutation.name);
+            return permutation;
+        }
     }
+    return kernelPermutations[std::size(kernelPermutations) - 1];
+}
+
 
+// Created once: it only depends on the swapchain format, which doesn't change on recreation
+void VulkanManager::createRenderPass() {
     // Define the render pass
     // Setup for a simple render pass with one color attachment
     VkAttachmentDescription colorAttachment{};
@@ -836,6 +1456,81 @@ void VulkanManager::createGraphicsPipeline() {
     if (vkCreateRenderPass(mDevice, &renderPassInfo, nullptr, &mRenderPass) != VK_SUCCESS) {
         throw std::runtime_error("failed to create render pass!");
     }
+}
+
+// Compiles on the worker pool; the render pass must already exist
+void VulkanManager::createGraphicsPipeline() {
+    VkRenderPass renderPass = mRenderPass;
+    mGraphicsPipeline = submitPipelineBuild([this, renderPass]() {
+        return buildGraphicsPipeline(renderPass);
+    });
+    mFrameCommands.renderDirty = true;
+}
+
+VkPipeline VulkanManager::buildGraphicsPipeline(VkRenderPass renderPass) {
+    VkShaderModule vertShaderModule = createShaderModule("vertex_shader");
+    VkShaderModule fragShaderModule = createShaderModule("fragment_shader");
+
+    // Define shader stage create info for vertex and fragment shaders
+    VkPipelineShaderStageCreateInfo vertShaderStageInfo = {};
+    vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
+    vertShaderStageInfo.module = vertShaderModule;
+    vertShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo fragShaderStageInfo = {};
+    fragShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    fragShaderStageInfo.stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    fragShaderStageInfo.module = fragShaderModule;
+    fragShaderStageInfo.pName = "main";
+
+    VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
+
+    // Define the pipeline's fixed-function stages (e.g., input assembly, viewport, rasterization)
+    // The vertex shader generates a full-screen triangle from gl_VertexIndex, so there is no vertex input.
+    VkPipelineVertexInputStateCreateInfo vertexInputInfo = {};
+    vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+    vertexInputInfo.vertexBindingDescriptionCount = 0;
+    vertexInputInfo.vertexAttributeDescriptionCount = 0;
+
+    // Configure input assembly based on your application's needs
+    VkPipelineInputAssemblyStateCreateInfo inputAssembly = {};
+    inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
+    inputAssembly.topology = VK_PRIMITIVE_TOPOLOGY_TRIANGLE_LIST;
+    inputAssembly.primitiveRestartEnable = VK_FALSE;
+
+    // Viewport and scissor are set when recording, so the pipeline outlives swapchain resizes
+    VkPipelineViewportStateCreateInfo viewportState = {};
+    viewportState.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
+    viewportState.viewportCount = 1;
+    viewportState.scissorCount = 1;
+
+    VkDynamicState dynamicStates[] = {VK_DYNAMIC_STATE_VIEWPORT, VK_DYNAMIC_STATE_SCISSOR};
+    VkPipelineDynamicStateCreateInfo dynamicState{};
+    dynamicState.sType = VK_STRUCTURE_TYPE_PIPELINE_DYNAMIC_STATE_CREATE_INFO;
+    dynamicState.dynamicStateCount = 2;
+    dynamicState.pDynamicStates = dynamicStates;
+
+    VkPipelineRasterizationStateCreateInfo rasterizer{};
+    rasterizer.sType = VK_STRUCTURE_TYPE_PIPELINE_RASTERIZATION_STATE_CREATE_INFO;
+    rasterizer.polygonMode = VK_POLYGON_MODE_FILL;
+    rasterizer.cullMode = VK_CULL_MODE_NONE;
+    rasterizer.frontFace = VK_FRONT_FACE_COUNTER_CLOCKWISE;
+    rasterizer.lineWidth = 1.0f;
+
+    VkPipelineMultisampleStateCreateInfo multisampling{};
+    multisampling.sType = VK_STRUCTURE_TYPE_PIPELINE_MULTISAMPLE_STATE_CREATE_INFO;
+    multisampling.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT;
+
+    VkPipelineColorBlendAttachmentState colorBlendAttachment{};
+    colorBlendAttachment.colorWriteMask = VK_COLOR_COMPONENT_R_BIT | VK_COLOR_COMPONENT_G_BIT |
+                                          VK_COLOR_COMPONENT_B_BIT | VK_COLOR_COMPONENT_A_BIT;
+    colorBlendAttachment.blendEnable = VK_FALSE;
+
+    VkPipelineColorBlendStateCreateInfo colorBlending{};
+    colorBlending.sType = VK_STRUCTURE_TYPE_PIPELINE_COLOR_BLEND_STATE_CREATE_INFO;
+    colorBlending.attachmentCount = 1;
+    colorBlending.pAttachments = &colorBlendAttachment;
 
     VkGraphicsPipelineCreateInfo pipelineInfo = {};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
@@ -844,147 +1539,260 @@ void VulkanManager::createGraphicsPipeline() {
     pipelineInfo.pVertexInputState = &vertexInputInfo;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
-    // Include other pipeline states
-    pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.renderPass = mRenderPass;
+    pipelineInfo.pRasterizationState = &rasterizer;
+    pipelineInfo.pMultisampleState = &multisampling;
+    pipelineInfo.pColorBlendState = &colorBlending;
+    pipelineInfo.pDynamicState = &dynamicState;
+    pipelineInfo.layout = mGraphicsPipelineLayout;  // Created in createPipelineLayout()
+    pipelineInfo.renderPass = renderPass;
 
 
-    if (vkCreateGraphicsPipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &mGraphicsPipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create graphics pipeline!");
-    }
+    VkPipeline pipeline;
+    VkResult result = vkCreateGraphicsPipelines(mDevice, mPipelineCache, 1, &pipelineInfo, nullptr, &pipeline);
 
     // Clean up temporary objects
     vkDestroyShaderModule(mDevice, vertShaderModule, nullptr);
     vkDestroyShaderModule(mDevice, fragShaderModule, nullptr);
-}
 
-
-void VulkanManager::createComputePipeline() {
-    // Read SPIR-V code from file
-    auto compShaderCode = readFile("shaders/compute_shader.spv");
-
-    // Create shader module
-    VkShaderModule compShaderModule = createShaderModule(compShaderCode);
-
-    // Shader stage setup for compute shader
-    VkPipelineShaderStageCreateInfo compShaderStageInfo = {};
-    compShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    compShaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    compShaderStageInfo.module = compShaderModule;
-    compShaderStageInfo.pName = "main";
-
-    // Create pipeline layout
-    VkDescriptorSetLayoutBinding layoutBinding{};
-    layoutBinding.binding = 0;
-    layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    layoutBinding.descriptorCount = 1;
-    layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    layoutBinding.pImmutableSamplers = nullptr;
-
-    VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo{};
-    descriptorLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorLayoutInfo.bindingCount = 1;
-    descriptorLayoutInfo.pBindings = &layoutBinding;
-
-    VkDescriptorSetLayout descriptorSetLayout;
-    if (vkCreateDescriptorSetLayout(mDevice, &descriptorLayoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create descriptor set layout!");
+    if (result != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics pipeline!");
     }
+    return pipeline;
+}
 
-    // Pipeline layout that uses this descriptor set layout
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1; // Use one descriptor set layout
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 0; // Optional: For passing small amounts of data
-    pipelineLayoutInfo.pPushConstantRanges = nullptr;
 
-    vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mComputePipelineLayout);
+// Queues a pipeline build on the worker pool. The shared VkPipelineCache needs no locking:
+// without VK_PIPELINE_CACHE_CREATE_EXTERNALLY_SYNCHRONIZED_BIT the driver synchronizes it.
+VulkanManager::PendingPipeline VulkanManager::submitPipelineBuild(std::function<VkPipeline()> build) {
+    PendingPipeline pipeline;
+    pipeline.build = mPipelineWorkers->submit(std::move(build)).share();
+    return pipeline;
+}
 
-    // Compute pipeline creation, using the created shader stage and pipeline layout
-    VkComputePipelineCreateInfo pipelineCreateInfo = {};
-    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    pipelineCreateInfo.stage = compShaderStageInfo;
-    pipelineCreateInfo.layout = mComputePipelineLayout;
-    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE; // Not deriving from an existing pipeline
-    pipelineCreateInfo.basePipelineIndex = -1; // Not deriving from an existing pipeline
+// Waits for the build if it is still running, so a pipeline is never leaked mid-compile
+void VulkanManager::destroyPipeline(PendingPipeline& pipeline) {
+    vkDestroyPipeline(mDevice, pipeline.get(), nullptr);
+    pipeline = PendingPipeline{};
+}
 
-    if (vkCreateComputePipelines(mDevice, VK_NULL_HANDLE, 1, &pipelineCreateInfo, nullptr, &mComputePipeline) != VK_SUCCESS) {
-        throw std::runtime_error("failed to create compute pipeline!");
-    }
+// Queues the solver for one specialization, plus the tile compaction and field reduction pipelines
+// from the same constants so their tiles line up with the solver's workgroups.
+VulkanManager::ComputePipelineSet VulkanManager::submitComputePipelines(const ComputeSpecialization& specialization,
+                                                                       const KernelPermutation& kernels) {
+    ComputePipelineSet pipelines;
+    pipelines.specialization = specialization;
+    pipelines.kernels = &kernels;
+    pipelines.solver = submitPipelineBuild([this, specialization, shader = std::string(kernels.solverShader)]() {
+        return createComputePipelineFromShader(shader, mComputePipelineLayout, &specialization);
+    });
+    pipelines.tileCompact = submitPipelineBuild([this, specialization]() {
+        return createComputePipelineFromShader("tile_compact", mTileCompactPipelineLayout, &specialization);
+    });
+    pipelines.reduce = submitPipelineBuild([this, specialization, shader = std::string(kernels.reduceShader)]() {
+        return createComputePipelineFromShader(shader, mReducePipelineLayout, &specialization);
+    });
+    return pipelines;
+}
 
-    setupComputeDescriptorSet();
+void VulkanManager::installComputePipelines(const ComputePipelineSet& pipelines) {
+    const ComputeSpecialization& specialization = pipelines.specialization;
+    mComputeSpecialization = specialization;
+    mComputePipeline = pipelines.solver;
+    mTileCompactPipeline = pipelines.tileCompact;
+    mReducePipeline = pipelines.reduce;
+    mFrameCommands.computeDirty = true;
+
+    LOGI("Compute pipeline (%s kernels): %ux%u workgroups, unroll %u, boundary mode %u, %ux%u grid",
+         pipelines.kernels->name, specialization.localSizeX, specialization.localSizeY, specialization.unroll,
+         specialization.boundaryMode, specialization.gridWidth, specialization.gridHeight);
+}
 
-    // Cleanup
-    vkDestroyShaderModule(mDevice, compShaderModule, nullptr);
+void VulkanManager::destroyComputePipeline() {
+    destroyPipeline(mComputePipeline);
+    destroyPipeline(mTileCompactPipeline);
+    destroyPipeline(mReducePipeline);
 }
 
-void VulkanManager::createPipelineLayout() {
-    VkDescriptorSetLayoutBinding layoutBinding{};
-    layoutBinding.binding = 0;
-    layoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    layoutBinding.descriptorCount = 1;
-    layoutBinding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    layoutBinding.pImmutableSamplers = nullptr; // Not needed for storage buffers
+VkDescriptorSetLayout VulkanManager::createStorageBufferSetLayout(uint32_t bindingCount, VkShaderStageFlags stageFlags) {
+    std::vector<VkDescriptorSetLayoutBinding> layoutBindings(bindingCount);
+    for (uint32_t i = 0; i < bindingCount; ++i) {
+        layoutBindings[i].binding = i;
+        layoutBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        layoutBindings[i].descriptorCount = 1;
+        layoutBindings[i].stageFlags = stageFlags;
+        layoutBindings[i].pImmutableSamplers = nullptr; // Not needed for storage buffers
+    }
 
     VkDescriptorSetLayoutCreateInfo descriptorLayoutInfo{};
     descriptorLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    descriptorLayoutInfo.bindingCount = 1;
-    descriptorLayoutInfo.pBindings = &layoutBinding;
+    descriptorLayoutInfo.bindingCount = bindingCount;
+    descriptorLayoutInfo.pBindings = layoutBindings.data();
 
-    VkDescriptorSetLayout descriptorSetLayout;
-    if (vkCreateDescriptorSetLayout(mDevice, &descriptorLayoutInfo, nullptr, &mDescriptorSetLayout) != VK_SUCCESS) {
+    VkDescriptorSetLayout setLayout;
+    if (vkCreateDescriptorSetLayout(mDevice, &descriptorLayoutInfo, nullptr, &setLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create descriptor set layout!");
     }
+    return setLayout;
+}
 
-    // Define push constant range
+// Set i of the layout is setLayouts[i]; a pushConstantSize of 0 means no push constants
+VkPipelineLayout VulkanManager::createPipelineLayoutFor(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                                        VkShaderStageFlags stageFlags, uint32_t pushConstantSize) {
     VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT; // Or combine flags for multiple stages
+    pushConstantRange.stageFlags = stageFlags;
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(PushConstantData); // Make sure this size matches the structure in shaders
+    pushConstantRange.size = pushConstantSize; // Make sure this size matches the structure in shaders
 
-    // Create the pipeline layout that includes both descriptor set layouts and push constants
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1; // We have one descriptor set layout
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1; // We are using push constants
+    pipelineLayoutInfo.setLayoutCount = static_cast<uint32_t>(setLayouts.size());
+    pipelineLayoutInfo.pSetLayouts = setLayouts.data();
+    pipelineLayoutInfo.pushConstantRangeCount = pushConstantSize > 0 ? 1 : 0;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-    if (vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &mComputePipelineLayout) != VK_SUCCESS) {
+    VkPipelineLayout pipelineLayout;
+    if (vkCreatePipelineLayout(mDevice, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         throw std::runtime_error("failed to create pipeline layout!");
     }
+    return pipelineLayout;
+}
 
-    // It's generally good practice to keep the descriptor set layout around if you will use it later
+// constant_id N is the Nth field of ComputeSpecialization; shaders ignore the IDs they don't declare
+const std::array<VkSpecializationMapEntry, 7>& VulkanManager::computeSpecializationMapEntries() {
+    static const std::array<VkSpecializationMapEntry, 7> mapEntries = {{
+            {0, offsetof(ComputeSpecialization, localSizeX), sizeof(uint32_t)},
+            {1, offsetof(ComputeSpecialization, localSizeY), sizeof(uint32_t)},
+            {2, offsetof(ComputeSpecialization, gridWidth), sizeof(uint32_t)},
+            {3, offsetof(ComputeSpecialization, gridHeight), sizeof(uint32_t)},
+            {4, offsetof(ComputeSpecialization, boundaryMode), sizeof(uint32_t)},
+            {5, offsetof(ComputeSpecialization, unroll), sizeof(uint32_t)},
+            {6, offsetof(ComputeSpecialization, quietPasses), sizeof(uint32_t)},
+    }};
+    return mapEntries;
+}
+
+VkPipeline VulkanManager::createComputePipelineFromShader(const std::string& shaderName, VkPipelineLayout layout,
+                                                          const ComputeSpecialization* specialization) {
+    VkShaderModule shaderModule = createShaderModule(shaderName);
+
+    const auto& mapEntries = computeSpecializationMapEntries();
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = static_cast<uint32_t>(mapEntries.size());
+    specializationInfo.pMapEntries = mapEntries.data();
+    specializationInfo.dataSize = sizeof(ComputeSpecialization);
+    specializationInfo.pData = specialization;
+
+    VkPipelineShaderStageCreateInfo shaderStageInfo = {};
+    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    shaderStageInfo.module = shaderModule;
+    shaderStageInfo.pName = "main";
+    shaderStageInfo.pSpecializationInfo = specialization ? &specializationInfo : nullptr;
+
+    VkComputePipelineCreateInfo pipelineCreateInfo = {};
+    pipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineCreateInfo.stage = shaderStageInfo;
+    pipelineCreateInfo.layout = layout;
+    pipelineCreateInfo.basePipelineHandle = VK_NULL_HANDLE;
+    pipelineCreateInfo.basePipelineIndex = -1;
+
+    VkPipeline pipeline;
+    if (vkCreateComputePipelines(mDevice, mPipelineCache, 1, &pipelineCreateInfo, nullptr, &pipeline) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create compute pipeline from " + shaderName);
+    }
+
+    vkDestroyShaderModule(mDevice, shaderModule, nullptr);
+    return pipeline;
+}
+
+void VulkanManager::createPipelineLayout() {
+    // Set 1 of the solver, tile compaction and graphics layouts: the FrameParams slot (binding 0),
+    // picked by dynamic offset, and the upload ring (binding 1)
+    std::array<VkDescriptorSetLayoutBinding, 2> paramsBindings{};
+    paramsBindings[0].binding = 0;
+    paramsBindings[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    paramsBindings[0].descriptorCount = 1;
+    paramsBindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+    paramsBindings[1].binding = 1;
+    paramsBindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    paramsBindings[1].descriptorCount = 1;
+    paramsBindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    VkDescriptorSetLayoutCreateInfo paramsLayoutInfo{};
+    paramsLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    paramsLayoutInfo.bindingCount = static_cast<uint32_t>(paramsBindings.size());
+    paramsLayoutInfo.pBindings = paramsBindings.data();
+    if (vkCreateDescriptorSetLayout(mDevice, &paramsLayoutInfo, nullptr, &mFrameParamsSetLayout) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor set layout!");
+    }
+
+    // Compute: velocity/pressure in (bindings 0, 1), velocity/pressure out (bindings 2, 3),
+    // active tile list (binding 4) and tile flags (binding 5)
+    mDescriptorSetLayout = createStorageBufferSetLayout(6, VK_SHADER_STAGE_COMPUTE_BIT);
+    mComputePipelineLayout = createPipelineLayoutFor({mDescriptorSetLayout, mFrameParamsSetLayout}, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    // Graphics: the fragment shader reads the previous (bindings 0, 1) and current (bindings 2, 3)
+    // velocity/pressure states and interpolates between them
+    mGraphicsDescriptorSetLayout = createStorageBufferSetLayout(4, VK_SHADER_STAGE_FRAGMENT_BIT);
+    mGraphicsPipelineLayout = createPipelineLayoutFor({mGraphicsDescriptorSetLayout, mFrameParamsSetLayout}, VK_SHADER_STAGE_FRAGMENT_BIT);
+
+    // Field reduction: velocity state (binding 0), the FieldStats slots (binding 1), pressure
+    // state (binding 2) and active tile list (binding 3)
+    mReduceDescriptorSetLayout = createStorageBufferSetLayout(4, VK_SHADER_STAGE_COMPUTE_BIT);
+    mReducePipelineLayout = createPipelineLayoutFor({mReduceDescriptorSetLayout}, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ReducePushConstantData));
+
+    // Tile compaction: tile flags (binding 0), active tile list (binding 1) and the indirect
+    // dispatch arguments (binding 2)
+    mTileCompactDescriptorSetLayout = createStorageBufferSetLayout(3, VK_SHADER_STAGE_COMPUTE_BIT);
+    mTileCompactPipelineLayout = createPipelineLayoutFor({mTileCompactDescriptorSetLayout, mFrameParamsSetLayout}, VK_SHADER_STAGE_COMPUTE_BIT);
+
+    // Grid resampling: velocity/pressure of the old grid (bindings 0, 1) and of the new one
+    // (bindings 2, 3); grid sizes and rotation as push constants
+    mResampleDescriptorSetLayout = createStorageBufferSetLayout(4, VK_SHADER_STAGE_COMPUTE_BIT);
+    mResamplePipelineLayout = createPipelineLayoutFor({mResampleDescriptorSetLayout}, VK_SHADER_STAGE_COMPUTE_BIT, sizeof(ResamplePushConstantData));
+
+    // It's generally good practice to keep the descriptor set layout around if you will use it later
     // for creating descriptor sets, do not destroy it immediately after creating the pipeline layout
 }
 
+// Sized for exactly the persistent sets: compute, graphics and reduction sets per sim state, the
+// tile compaction set and the FrameParams set
+void VulkanManager::createDescriptorPool() {
+    auto stateCount = static_cast<uint32_t>(mSimStates.size());
+    std::array<VkDescriptorPoolSize, 2> poolSizes = {{
+            {VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, stateCount * (6 + 4 + 4) + 3 + 1},
+            {VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1},
+    }};
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
+    poolInfo.pPoolSizes = poolSizes.data();
+    poolInfo.maxSets = stateCount * 3 + 2;
+    if (vkCreateDescriptorPool(mDevice, &poolInfo, nullptr, &mDescriptorPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create descriptor pool!");
+    }
+}
 
-// this to be called from createComputePipeline() at the end of the function.
-void VulkanManager::setupComputeDescriptorSet() {
-    // Allocate descriptor set first
+VkDescriptorSet VulkanManager::allocateDescriptorSet(VkDescriptorSetLayout setLayout) {
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = mDescriptorPool;  // Make sure you've created this
+    allocInfo.descriptorPool = mDescriptorPool;
     allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &mDescriptorSetLayout;
+    allocInfo.pSetLayouts = &setLayout;
 
-    if (vkAllocateDescriptorSets(mDevice, &allocInfo, &mDescriptorSet) != VK_SUCCESS) {
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(mDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate descriptor sets!");
     }
+    return descriptorSet;
+}
 
-    // Assume buffers are created and named mVelocityBuffer, mPressureBuffer, etc.
-    std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
-    bufferInfos[0] = {mVelocityBuffer, 0, VK_WHOLE_SIZE};
-    bufferInfos[1] = {mPressureBuffer, 0, VK_WHOLE_SIZE};
-    bufferInfos[2] = {mVelocityOutputBuffer, 0, VK_WHOLE_SIZE};
-    bufferInfos[3] = {mPressureOutputBuffer, 0, VK_WHOLE_SIZE};
-
-    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
+// Binding i of `descriptorSet` gets bufferInfos[i]
+void VulkanManager::writeStorageBufferSet(VkDescriptorSet descriptorSet, const std::vector<VkDescriptorBufferInfo>& bufferInfos) {
+    std::vector<VkWriteDescriptorSet> descriptorWrites(bufferInfos.size());
 
     for (size_t i = 0; i < bufferInfos.size(); ++i) {
         descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[i].dstSet = mDescriptorSet;
+        descriptorWrites[i].dstSet = descriptorSet;
         descriptorWrites[i].dstBinding = static_cast<uint32_t>(i);
         descriptorWrites[i].dstArrayElement = 0;
         descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
@@ -995,10 +1803,75 @@ void VulkanManager::setupComputeDescriptorSet() {
     vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 }
 
+// Called once the shader buffers exist, and again whenever they are reallocated, which rewrites
+// the sets in place. Set k reads state k and writes the next state in the ring.
+void VulkanManager::setupComputeDescriptorSet() {
+    mComputeDescriptorSets.resize(mSimStates.size());
+    for (uint32_t state = 0; state < mSimStates.size(); ++state) {
+        const SimState& input = mSimStates[state];
+        const SimState& output = mSimStates[nextSimState(state)];
+        if (mComputeDescriptorSets[state] == VK_NULL_HANDLE) {
+            mComputeDescriptorSets[state] = allocateDescriptorSet(mDescriptorSetLayout);
+        }
+        writeStorageBufferSet(mComputeDescriptorSets[state], {
+                {input.velocity, 0, VK_WHOLE_SIZE},
+                {input.pressure, 0, VK_WHOLE_SIZE},
+                {output.velocity, 0, VK_WHOLE_SIZE},
+                {output.pressure, 0, VK_WHOLE_SIZE},
+                {mTileListBuffer, 0, VK_WHOLE_SIZE},
+                {mTileFlagsBuffer, 0, VK_WHOLE_SIZE},
+        });
+    }
+}
+
+// Set k renders state k (current) interpolated from the state before it in the ring (previous).
+void VulkanManager::setupGraphicsDescriptorSets() {
+    mGraphicsDescriptorSets.resize(mSimStates.size());
+    for (uint32_t state = 0; state < mSimStates.size(); ++state) {
+        const SimState& current = mSimStates[state];
+        const SimState& previous = mSimStates[previousSimState(state)];
+        if (mGraphicsDescriptorSets[state] == VK_NULL_HANDLE) {
+            mGraphicsDescriptorSets[state] = allocateDescriptorSet(mGraphicsDescriptorSetLayout);
+        }
+        writeStorageBufferSet(mGraphicsDescriptorSets[state], {
+                {previous.velocity, 0, VK_WHOLE_SIZE},
+                {previous.pressure, 0, VK_WHOLE_SIZE},
+                {current.velocity, 0, VK_WHOLE_SIZE},
+                {current.pressure, 0, VK_WHOLE_SIZE},
+        });
+    }
+}
+
+// Set k reduces state k into the FieldStats slots.
+void VulkanManager::setupReduceDescriptorSets() {
+    mReduceDescriptorSets.resize(mSimStates.size());
+    for (uint32_t state = 0; state < mSimStates.size(); ++state) {
+        if (mReduceDescriptorSets[state] == VK_NULL_HANDLE) {
+            mReduceDescriptorSets[state] = allocateDescriptorSet(mReduceDescriptorSetLayout);
+        }
+        writeStorageBufferSet(mReduceDescriptorSets[state], {
+                {mSimStates[state].velocity, 0, VK_WHOLE_SIZE},
+                {mFieldStatsBuffer, 0, VK_WHOLE_SIZE},
+                {mSimStates[state].pressure, 0, VK_WHOLE_SIZE},
+                {mTileListBuffer, 0, VK_WHOLE_SIZE},
+        });
+    }
+}
+
+void VulkanManager::setupTileCompactDescriptorSet() {
+    if (mTileCompactDescriptorSet == VK_NULL_HANDLE) {
+        mTileCompactDescriptorSet = allocateDescriptorSet(mTileCompactDescriptorSetLayout);
+    }
+    writeStorageBufferSet(mTileCompactDescriptorSet, {
+            {mTileFlagsBuffer, 0, VK_WHOLE_SIZE},
+            {mTileListBuffer, 0, VK_WHOLE_SIZE},
+            {mTileArgsBuffer, 0, VK_WHOLE_SIZE},
+    });
+}
 
 void VulkanManager::createCommandBufferForCompute() {
     // Create the Command Pool
-    QueueFamilyIndices queueFamilyIndices = findQueueFamilies(mPhysicalDevice, mSurface);
+    const QueueFamilyIndices& queueFamilyIndices = mDeviceProfile->queueFamilies;
 
     VkCommandPoolCreateInfo poolInfo{};
     poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
@@ -1008,37 +1881,103 @@ void VulkanManager::createCommandBufferForCompute() {
     //VkCommandPool computeCommandPool;
     vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mComputeCommandPool); // Create the compute command pool
 
+    // The buffers themselves are allocated by recordFrameComputeCommands()
+    mFrameCommands.computeDirty = true;
+}
+
+// Holds the pre-recorded fragment passes; per-frame work goes to the frame contexts' pools
+void VulkanManager::createGraphicsCommandPool() {
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    poolInfo.queueFamilyIndex = mDeviceProfile->queueFamilies.graphicsFamily.value();
+    if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &mGraphicsCommandPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create graphics command pool!");
+    }
+}
+
+// Presents one image cleared to the background colour, so the window shows something while the
+// simulation is still being set up. Waits for it, leaving frame context 0 free for drawFrame.
+void VulkanManager::presentClearFrame() {
+    FrameContext& frame = mFrameContexts[0];
+    uint32_t imageIndex;
+    VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
+    if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
+        LOGE("Skipping the clear frame, acquire failed: %d", result);
+        return;
+    }
+
+    // Freed when drawFrame() first resets the context's pool
     VkCommandBufferAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
     allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = mComputeCommandPool;  // Using the newly created compute command pool
+    allocInfo.commandPool = frame.commandPool;
     allocInfo.commandBufferCount = 1;
-
-    //VkCommandBuffer mComputeCommandBuffer;
-    vkAllocateCommandBuffers(mDevice, &allocInfo, &mComputeCommandBuffer);
-
-    // Set up the command buffer begin information
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate clear frame command buffer!");
+    }
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = 0;  // Optional: Specify usage flags depending on how you plan to use this command buffer
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
 
-    vkBeginCommandBuffer(mComputeCommandBuffer, &beginInfo);  // Begin recording the command buffer
-    vkCmdBindPipeline(mComputeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipeline);
-    vkCmdBindDescriptorSets(mComputeCommandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr);
+    // The render pass clears on load; with no draws that's the whole frame
+    VkRenderPassBeginInfo renderPassInfo{};
+    renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+    renderPassInfo.renderPass = mRenderPass;
+    renderPassInfo.framebuffer = mFramebuffers[imageIndex];
+    renderPassInfo.renderArea.extent = mSwapChainExtent;
+    VkClearValue clearColor = {{0.0f, 0.0f, 0.0f, 1.0f}};
+    renderPassInfo.clearValueCount = 1;
+    renderPassInfo.pClearValues = &clearColor;
+    vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+    vkCmdEndRenderPass(commandBuffer);
+    vkEndCommandBuffer(commandBuffer);
 
-    // Specify the number of workgroups to dispatch in the compute shader
-    vkCmdDispatch(mComputeCommandBuffer, (mSwapChainExtent.width + 15) / 16,
-                  (mSwapChainExtent.height + 15) / 16, 1); // Assuming local_size_x = local_size_y = 16 in shader
+    VkFenceCreateInfo fenceInfo{};
+    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+    VkFence fence;
+    if (vkCreateFence(mDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create clear frame fence!");
+    }
+
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &frame.imageAvailable;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    submitInfo.signalSemaphoreCount = 1;
+    submitInfo.pSignalSemaphores = &frame.renderFinished;
+    vkQueueSubmit(mGraphicsQueue, 1, &submitInfo, fence);
 
-    vkEndCommandBuffer(mComputeCommandBuffer); // End recording the command buffer
+    VkPresentInfoKHR presentInfo{};
+    presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+    presentInfo.waitSemaphoreCount = 1;
+    presentInfo.pWaitSemaphores = &frame.renderFinished;
+    presentInfo.swapchainCount = 1;
+    presentInfo.pSwapchains = &mSwapChain;
+    presentInfo.pImageIndices = &imageIndex;
+    vkQueuePresentKHR(mPresentQueue, &presentInfo);
 
+    vkWaitForFences(mDevice, 1, &fence, VK_TRUE, UINT64_MAX);
+    vkDestroyFence(mDevice, fence, nullptr);
 }
 
-VkShaderModule VulkanManager::createShaderModule(const std::vector<char>& code) {
+// Shaders are embedded in the library (EmbeddedShaders.h), so this never touches the filesystem
+VkShaderModule VulkanManager::createShaderModule(const std::string& shaderName) {
+    const EmbeddedShader* shader = findEmbeddedShader(shaderName.c_str());
+    if (shader == nullptr) {
+        throw std::runtime_error("no embedded shader named " + shaderName);
+    }
+
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    createInfo.codeSize = code.size();
-    createInfo.pCode = reinterpret_cast<const uint32_t*>(code.data());
+    createInfo.codeSize = shader->size;
+    createInfo.pCode = shader->code;
 
     VkShaderModule shaderModule;
     if (vkCreateShaderModule(mDevice, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
@@ -1048,21 +1987,72 @@ VkShaderModule VulkanManager::createShaderModule(const std::vector<char>& code)
     return shaderModule;
 }
 
-std::vector<char> VulkanManager::readFile(const std::string& filename) {
-    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+// The driver's pipeline cache blob is prefixed with our own header recording the driver version,
+// which the Vulkan cache header doesn't carry. A blob from another device, driver or cache layout
+// is discarded rather than handed to the driver.
+struct PipelineCacheFileHeader {
+    uint32_t magic;
+    uint32_t driverVersion;
+    uint32_t dataSize;
+};
+static const uint32_t kPipelineCacheMagic = 0x50325346;  // "FS2P"
+
+void VulkanManager::createPipelineCache() {
+    const VkPhysicalDeviceProperties& properties = mDeviceProfile->properties;
+    std::vector<char> data;
+
+    std::ifstream file(mFilesDir + "/pipeline.cache", std::ios::binary);
+    PipelineCacheFileHeader fileHeader{};
+    if (file.read(reinterpret_cast<char*>(&fileHeader), sizeof(fileHeader)) &&
+        fileHeader.magic == kPipelineCacheMagic && fileHeader.driverVersion == properties.driverVersion &&
+        fileHeader.dataSize >= sizeof(VkPipelineCacheHeaderVersionOne)) {
+        data.resize(fileHeader.dataSize);
+        if (!file.read(data.data(), data.size())) {
+            data.clear();
+        }
+    }
 
-    if (!file.is_open()) {
-        throw std::runtime_error("failed to open file: " + filename);
+    if (!data.empty()) {
+        VkPipelineCacheHeaderVersionOne cacheHeader;
+        std::memcpy(&cacheHeader, data.data(), sizeof(cacheHeader));
+        if (cacheHeader.headerVersion != VK_PIPELINE_CACHE_HEADER_VERSION_ONE ||
+            cacheHeader.vendorID != properties.vendorID || cacheHeader.deviceID != properties.deviceID ||
+            std::memcmp(cacheHeader.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) != 0) {
+            data.clear();
+        }
     }
+    LOGI("Pipeline cache: loaded %zu bytes", data.size());
 
-    size_t fileSize = (size_t) file.tellg();
-    std::vector<char> buffer(fileSize);
+    VkPipelineCacheCreateInfo cacheInfo{};
+    cacheInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+    cacheInfo.initialDataSize = data.size();
+    cacheInfo.pInitialData = data.empty() ? nullptr : data.data();
+    if (vkCreatePipelineCache(mDevice, &cacheInfo, nullptr, &mPipelineCache) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create pipeline cache!");
+    }
+}
 
-    file.seekg(0);
-    file.read(buffer.data(), fileSize);
+void VulkanManager::savePipelineCache() {
+    size_t dataSize = 0;
+    if (vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, nullptr) != VK_SUCCESS || dataSize == 0) {
+        return;
+    }
+    std::vector<char> data(dataSize);
+    if (vkGetPipelineCacheData(mDevice, mPipelineCache, &dataSize, data.data()) != VK_SUCCESS) {
+        return;
+    }
 
+    // Write to a temporary file and rename so a process killed mid-write can't leave a torn cache
+    std::string path = mFilesDir + "/pipeline.cache";
+    std::ofstream file(path + ".tmp", std::ios::binary | std::ios::trunc);
+    PipelineCacheFileHeader fileHeader{kPipelineCacheMagic, mDeviceProfile->properties.driverVersion,
+                                       static_cast<uint32_t>(dataSize)};
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+    file.write(data.data(), static_cast<std::streamsize>(dataSize));
     file.close();
-    return buffer;
+    if (!file || std::rename((path + ".tmp").c_str(), path.c_str()) != 0) {
+        LOGE("Failed to save pipeline cache to %s", path.c_str());
+    }
 }
 
 void VulkanManager::createSharedTexture() {
@@ -1094,16 +2084,18 @@ void VulkanManager::createSharedTexture() {
     allocInfo.allocationSize = memRequirements.size;
     allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
 
-    VkDeviceMemory textureImageMemory;
-    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &textureImageMemory) != VK_SUCCESS) {
+    if (vkAllocateMemory(mDevice, &allocInfo, nullptr, &mTextureImageMemory) != VK_SUCCESS) {
         throw std::runtime_error("failed to allocate image memory!");
     }
-    vkBindImageMemory(mDevice, mTextureImage, textureImageMemory, 0);
+    vkBindImageMemory(mDevice, mTextureImage, mTextureImageMemory, 0);
 }
 
 uint32_t VulkanManager::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(mPhysicalDevice, &memProperties);
+    return findMemoryType(mDeviceProfile->memoryProperties, typeFilter, properties);
+}
+
+uint32_t VulkanManager::findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+                                       VkMemoryPropertyFlags properties) {
 
     for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
         if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
@@ -1114,95 +2106,329 @@ uint32_t VulkanManager::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlag
     throw std::runtime_error("failed to find suitable memory type!");
 }
 
-void VulkanManager::initSynchronization() {
-    mInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    mImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    mRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-
-    VkSemaphoreCreateInfo semaphoreInfo = {};
+void VulkanManager::initSemaphores() {
+    VkSemaphoreCreateInfo semaphoreInfo{};
     semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+    VkSemaphoreTypeCreateInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+    timelineInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+    timelineInfo.initialValue = 0;
+    semaphoreInfo.pNext = &timelineInfo;
+    if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mSimTimeline) != VK_SUCCESS ||
+        vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mRenderTimeline) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to create timeline semaphores");
+    }
+    mFrameValue = 0;
+}
 
-    VkFenceCreateInfo fenceInfo = {};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;  // Start all fences as signaled
+void VulkanManager::createFrameContexts() {
+    mFrameContexts.resize(MAX_FRAMES_IN_FLIGHT);
+    for (uint32_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i) {
+        FrameContext& frame = mFrameContexts[i];
+
+        VkCommandPoolCreateInfo poolInfo{};
+        poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;  // Reset as a whole, never per buffer
+        poolInfo.queueFamilyIndex = mDeviceProfile->queueFamilies.graphicsFamily.value();
+        if (vkCreateCommandPool(mDevice, &poolInfo, nullptr, &frame.commandPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame command pool!");
+        }
 
-    for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mImageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mRenderFinishedSemaphores[i]) != VK_SUCCESS ||
-            vkCreateFence(mDevice, &fenceInfo, nullptr, &mInFlightFences[i]) != VK_SUCCESS) {
-            throw std::runtime_error("failed to create synchronization objects for a frame");
+        // Only storage buffer sets are allocated per frame, the grid resample's and the autotuning
+        // steps'; none has more bindings than the solver's six
+        VkDescriptorPoolSize poolSize{VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, FRAME_DESCRIPTOR_SETS * 6};
+        VkDescriptorPoolCreateInfo descriptorPoolInfo{};
+        descriptorPoolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+        descriptorPoolInfo.poolSizeCount = 1;
+        descriptorPoolInfo.pPoolSizes = &poolSize;
+        descriptorPoolInfo.maxSets = FRAME_DESCRIPTOR_SETS;
+        if (vkCreateDescriptorPool(mDevice, &descriptorPoolInfo, nullptr, &frame.descriptorPool) != VK_SUCCESS) {
+            throw std::runtime_error("failed to create frame descriptor pool!");
         }
-    }
 
+        // Binary semaphores only for acquire and present, which can't use timelines
+        VkSemaphoreCreateInfo semaphoreInfo{};
+        semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &frame.imageAvailable) != VK_SUCCESS ||
+            vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &frame.renderFinished) != VK_SUCCESS) {
+            throw std::runtime_error("Failed to create semaphores for frame " + std::to_string(i));
+        }
+
+        frame.paramsOffset = i * frameParamsStride();
+    }
+    mFrameIndex = 0;
 }
 
-void VulkanManager::initVulkanFences() {
-    mInFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;  // Start with fences signaled
+// Waits for the last frame that used the next frame context, then recycles everything it owns:
+// one call each for its command buffers and descriptor sets, and its share of the upload ring.
+// Objects retired up to that frame are destroyed too.
+VulkanManager::FrameContext& VulkanManager::beginFrame() {
+    FrameContext& frame = mFrameContexts[mFrameIndex];
+    waitTimeline(mRenderTimeline, frame.renderValue);
+    vkResetCommandPool(mDevice, frame.commandPool, 0);
+    vkResetDescriptorPool(mDevice, frame.descriptorPool, 0);
+    mUploadRing.release(frame.renderValue);
+    mDeletionQueue.flush(frame.renderValue);
+    return frame;
+}
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateFence(mDevice, &fenceInfo, nullptr, &mInFlightFences[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create synchronization fences for frame " + std::to_string(i));
+// Bump-allocates `size` bytes of the upload ring for the frame being built. The memory is host
+// coherent and stays untouched until the GPU has finished the frame. Offsets are aligned for use
+// as a storage buffer descriptor offset as well as to `alignment`. A frame that outruns the ring
+// waits for the oldest frame still holding part of it.
+VulkanManager::UploadAllocation VulkanManager::uploadAllocate(VkDeviceSize size, VkDeviceSize alignment) {
+    alignment = std::max(alignment, mDeviceProfile->properties.limits.minStorageBufferOffsetAlignment);
+    uint64_t offset;
+    while (!mUploadRing.allocate(size, alignment, offset)) {
+        if (!mUploadRing.hasPendingFrames()) {
+            throw std::runtime_error("upload doesn't fit in the upload ring!");
         }
+        uint64_t oldest = mUploadRing.oldestPendingFrame();
+        waitTimeline(mRenderTimeline, oldest);
+        mUploadRing.release(oldest);
     }
+    return {offset, mUploadMapped + mUploadRingBase + offset};
 }
 
-void VulkanManager::initSemaphores() {
-    mImageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-    mRenderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-
-    VkSemaphoreCreateInfo semaphoreInfo{};
-    semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+// A descriptor set that only lives until the frame context is next reused; never freed individually
+VkDescriptorSet VulkanManager::allocateFrameDescriptorSet(FrameContext& frame, VkDescriptorSetLayout setLayout) {
+    VkDescriptorSetAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+    allocInfo.descriptorPool = frame.descriptorPool;
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &setLayout;
 
-    for (int i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        if (vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mImageAvailableSemaphores[i]) != VK_SUCCESS ||
-            vkCreateSemaphore(mDevice, &semaphoreInfo, nullptr, &mRenderFinishedSemaphores[i]) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create semaphores for frame " + std::to_string(i));
-        }
+    VkDescriptorSet descriptorSet;
+    if (vkAllocateDescriptorSets(mDevice, &allocInfo, &descriptorSet) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate frame descriptor set!");
     }
+    return descriptorSet;
 }
 
-void VulkanManager::initImagesInFlight() {
-    mImagesInFlight.resize(mSwapChainImageCount, VK_NULL_HANDLE);  // Initialize with VK_NULL_HANDLE indicating no fence is associated initially.
+// Blocks until `timeline` reaches `value`. Frame values start at 1, so waiting for 0 is free.
+void VulkanManager::waitTimeline(VkSemaphore timeline, uint64_t value) {
+    if (value == 0) {
+        return;
+    }
+    VkSemaphoreWaitInfo waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+    waitInfo.semaphoreCount = 1;
+    waitInfo.pSemaphores = &timeline;
+    waitInfo.pValues = &value;
+    mWaitSemaphores(mDevice, &waitInfo, UINT64_MAX);
+}
 
-    // mSwapChainImages and mInFlightFences are already initialized
-    for (size_t i = 0; i < mSwapChainImageCount; ++i) {
-        VkFenceCreateInfo fenceInfo{};
-        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-        fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;  // Start with fences signaled
+// Reduces velocity state `state` over the tiles of the last solver pass into FieldStats slot `slot`
+// and makes the result visible to the host. Tiles outside the list are settled and contribute nothing.
+void VulkanManager::recordFieldReduce(VkCommandBuffer commandBuffer, uint32_t state, uint32_t slot) {
+    FrameGraph graph;
+    FrameGraphResources resources = importFrameResources(graph, SOLVER_PRIOR_STAGES);
+    addFieldReducePass(graph, resources, state, slot);
+    executeFrameGraph(commandBuffer, graph);
+}
 
-        VkFence fence;
-        if (vkCreateFence(mDevice, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
-            throw std::runtime_error("Failed to create fence for image in flight");
-        }
+// Called once the frame that owns `slot` has passed on the render timeline, so this never waits on the GPU.
+// The slot is cleared for that frame's next reduction. Returns whether the slot held new results.
+bool VulkanManager::readFieldStats(uint32_t slot) {
+    bool hasNewStats = mFieldStatsPending[slot];
+    if (hasNewStats) {
+        const FieldStats& stats = mFieldStats[slot];
+        std::memcpy(&mMaxSpeed, &stats.maxSpeedBits, sizeof(float));
+        mActivity = static_cast<float>(stats.kineticEnergy) / FIELD_STATS_FIXED_POINT_SCALE +
+                    static_cast<float>(stats.pressureMass) / FIELD_STATS_FIXED_POINT_SCALE;
+        mFieldStatsPending[slot] = false;
+    }
+    mFieldStats[slot] = FieldStats{};
+    return hasNewStats;
+}
 
-        mImagesInFlight[i] = fence;  // Store the fence
+// Puts the render loop to sleep once the field has stayed below QUIESCENCE_THRESHOLD for
+// QUIESCENT_READBACKS_TO_SLEEP readbacks in a row with nobody touching. updateTouch() wakes it.
+void VulkanManager::updateQuiescence(bool hasNewStats, bool isTouching) {
+    if (isTouching || mActivity >= QUIESCENCE_THRESHOLD) {
+        mQuiescentReadbacks = 0;
+        return;
+    }
+    if (hasNewStats && ++mQuiescentReadbacks >= QUIESCENT_READBACKS_TO_SLEEP) {
+        LOGI("Field is quiescent (activity %f), sleeping until touch", mActivity);
+        mQuiescentReadbacks = 0;
+        std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+        mSimIdle = true;
     }
 }
 
-void VulkanManager::recordComputeOperations(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
-    // Bind the compute pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipeline);
+// Marks every tile active for as many passes as there are states, so each state in the ring gets
+// a full sweep of whatever the others hold, and sets the constant y/z group counts of the indirect
+// arguments.
+void VulkanManager::recordTileStateReset(VkCommandBuffer commandBuffer) {
+    FrameGraph graph;
+    FrameGraphResources resources = importFrameResources(graph, SOLVER_PRIOR_STAGES);
+    addTileResetPass(graph, resources);
+    executeFrameGraph(commandBuffer, graph);
+}
+
+// Records one solver step reading state `state` and writing the next one in the ring
+void VulkanManager::recordComputeOperations(VkCommandBuffer commandBuffer, uint32_t state, uint32_t paramsSlot) {
+    FrameGraph graph;
+    FrameGraphResources resources = importFrameResources(graph, SOLVER_PRIOR_STAGES);
+    addSolverStepPasses(graph, resources, state, paramsSlot);
+    executeFrameGraph(commandBuffer, graph);
+}
+
+// Every buffer the solver and the fragment pass share. A graph recorded on its own can't see what
+// came before it in the queue, so each buffer's first use waits for any of `priorStages` writing it.
+VulkanManager::FrameGraphResources VulkanManager::importFrameResources(FrameGraph& graph, VkPipelineStageFlags2KHR priorStages) {
+    FrameGraph::Access prior{priorStages, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR};
+    FrameGraphResources resources;
+    resources.tileFlags = graph.importBuffer("tile flags", prior);
+    resources.tileList = graph.importBuffer("tile list", prior);
+    resources.tileArgs = graph.importBuffer("tile args", prior);
+    resources.fieldStats = graph.importBuffer("field stats", prior);
+    resources.stepSnapshot = graph.importBuffer("step snapshot", prior);
+    for (size_t state = 0; state < mSimStates.size(); ++state) {
+        resources.states.push_back(graph.importBuffer("sim state " + std::to_string(state), prior));
+    }
+    return resources;
+}
+
+void VulkanManager::addTileResetPass(FrameGraph& graph, const FrameGraphResources& resources) {
+    graph.addPass("tile reset", [this](VkCommandBuffer commandBuffer) {
+                // As if every tile had just held smoke, so each state in the ring gets a full sweep
+                vkCmdFillBuffer(commandBuffer, mTileFlagsBuffer, 0, VK_WHOLE_SIZE, mComputeSpecialization.quietPasses + 1);
+                vkCmdFillBuffer(commandBuffer, mTileArgsBuffer, 0, VK_WHOLE_SIZE, 1);
+            })
+            .writes(resources.tileFlags, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR)
+            .writes(resources.tileArgs, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+}
+
+// One solver step from `state` into the next state in the ring: compacts the active tiles left by
+// the previous step, then runs the solver over just those tiles
+void VulkanManager::addSolverStepPasses(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state, uint32_t paramsSlot) {
+    graph.addPass("tile args reset", [this](VkCommandBuffer commandBuffer) {
+                vkCmdFillBuffer(commandBuffer, mTileArgsBuffer, 0, sizeof(uint32_t), 0);  // groupCountX
+            })
+            .writes(resources.tileArgs, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+
+    // Compact the tiles worth updating into the list and the indirect arguments
+    graph.addPass("tile compact", [this, paramsSlot](VkCommandBuffer commandBuffer) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mTileCompactPipeline.get());
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mTileCompactPipelineLayout, 0, 1, &mTileCompactDescriptorSet, 0, nullptr);
+                bindFrameParams(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mTileCompactPipelineLayout, paramsSlot);
+                vkCmdDispatch(commandBuffer, (mComputeSpecialization.tileCount() + 63) / 64, 1, 1);
+            })
+            .reads(resources.tileFlags, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .reads(resources.tileArgs, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .writes(resources.tileArgs, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+            .writes(resources.tileList, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR);
+
+    // One workgroup per active tile
+    graph.addPass("solver", [this, state, paramsSlot](VkCommandBuffer commandBuffer) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipeline.get());
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipelineLayout, 0, 1, &mComputeDescriptorSets[state], 0, nullptr);
+                bindFrameParams(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipelineLayout, paramsSlot);
+                vkCmdDispatchIndirect(commandBuffer, mTileArgsBuffer, 0);
+            })
+            .reads(resources.tileArgs, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR)
+            .reads(resources.tileList, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .reads(resources.states[state], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .writes(resources.states[nextSimState(state)], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+            .writes(resources.tileFlags, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR);
+}
+
+// Folds `state` into FieldStats slot `slot`, which the host reads once the frame has passed
+void VulkanManager::addFieldReducePass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state, uint32_t slot) {
+    // One workgroup per active tile, same arguments as the solver pass that produced the state
+    graph.addPass("field reduce", [this, state, slot](VkCommandBuffer commandBuffer) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mReducePipeline.get());
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mReducePipelineLayout, 0, 1, &mReduceDescriptorSets[state], 0, nullptr);
+                ReducePushConstantData reduceData{slot};
+                vkCmdPushConstants(commandBuffer, mReducePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ReducePushConstantData), &reduceData);
+                vkCmdDispatchIndirect(commandBuffer, mTileArgsBuffer, 0);
+            })
+            .reads(resources.tileArgs, VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT_KHR)
+            .reads(resources.tileList, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .reads(resources.states[state], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .writes(resources.fieldStats, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR);
+    graph.exportResource(resources.fieldStats, {VK_PIPELINE_STAGE_2_HOST_BIT_KHR, VK_ACCESS_2_HOST_READ_BIT_KHR});
+}
+
+// Saves `state`, the end of the last full step, before a frame's last step runs as CFL substeps
+void VulkanManager::addStepSnapshotPass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state) {
+    graph.addPass("step snapshot", [this, state](VkCommandBuffer commandBuffer) {
+                recordStepCopy(commandBuffer, state, false);
+            })
+            .reads(resources.states[state], VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR)
+            .writes(resources.stepSnapshot, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+}
+
+// Puts the saved state back in `state`, the one before the latest, so the fragment pass
+// interpolates across a whole step rather than the last substep
+void VulkanManager::addStepRestorePass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state) {
+    graph.addPass("step restore", [this, state](VkCommandBuffer commandBuffer) {
+                recordStepCopy(commandBuffer, state, true);
+            })
+            .reads(resources.stepSnapshot, VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR)
+            .writes(resources.states[state], VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+}
+
+void VulkanManager::recordStepCopy(VkCommandBuffer commandBuffer, uint32_t state, bool restore) {
+    VkDeviceSize cellCount = static_cast<VkDeviceSize>(mComputeSpecialization.gridWidth) * mComputeSpecialization.gridHeight;
+    VkBufferCopy velocityCopy{0, 0, cellCount * sizeof(float) * 2};
+    VkBufferCopy pressureCopy{0, 0, cellCount * sizeof(float)};
+    const SimState& source = restore ? mStepSnapshot : mSimStates[state];
+    const SimState& destination = restore ? mSimStates[state] : mStepSnapshot;
+    vkCmdCopyBuffer(commandBuffer, source.velocity, destination.velocity, 1, &velocityCopy);
+    vkCmdCopyBuffer(commandBuffer, source.pressure, destination.pressure, 1, &pressureCopy);
+}
 
-    // Bind descriptor sets for compute shader
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipelineLayout, 0, 1, &mDescriptorSet, 0, nullptr);
+// Renders `state` interpolated from the one before it. Draws to the swapchain, which the graph
+// doesn't track, so it is never culled.
+void VulkanManager::addRenderPass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t imageIndex, uint32_t state, uint32_t paramsSlot) {
+    graph.addPass("render", [this, imageIndex, state, paramsSlot](VkCommandBuffer commandBuffer) {
+                recordRenderPass(commandBuffer, imageIndex, state, paramsSlot);
+            })
+            .reads(resources.states[state], VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .reads(resources.states[previousSimState(state)], VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .hasSideEffects();
+}
 
-    // Dispatch the compute operations, you need to define how many groups to dispatch
-    uint32_t groupCountX = (mSwapChainExtent.width + 15) / 16;  // Assuming each group handles a 16x16 block
-    uint32_t groupCountY = (mSwapChainExtent.height + 15) / 16;
-    vkCmdDispatch(commandBuffer, groupCountX, groupCountY, 1);
+// Records the graph's passes with its derived barriers: through synchronization2 when the device
+// was created with it, otherwise as legacy barriers, whose flag values the graph's all share
+void VulkanManager::executeFrameGraph(VkCommandBuffer commandBuffer, FrameGraph& graph) {
+    graph.compile();
+    graph.execute(commandBuffer, [this](VkCommandBuffer commandBuffer, const VkMemoryBarrier2KHR& barrier) {
+        if (mCmdPipelineBarrier2) {
+            VkDependencyInfoKHR dependencyInfo{};
+            dependencyInfo.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO_KHR;
+            dependencyInfo.memoryBarrierCount = 1;
+            dependencyInfo.pMemoryBarriers = &barrier;
+            mCmdPipelineBarrier2(commandBuffer, &dependencyInfo);
+            return;
+        }
+        VkMemoryBarrier legacyBarrier{};
+        legacyBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+        legacyBarrier.srcAccessMask = static_cast<VkAccessFlags>(barrier.srcAccessMask);
+        legacyBarrier.dstAccessMask = static_cast<VkAccessFlags>(barrier.dstAccessMask);
+        vkCmdPipelineBarrier(commandBuffer, static_cast<VkPipelineStageFlags>(barrier.srcStageMask),
+                             static_cast<VkPipelineStageFlags>(barrier.dstStageMask), 0, 1, &legacyBarrier, 0, nullptr, 0, nullptr);
+    });
 }
 
-void VulkanManager::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex) {
+void VulkanManager::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t state, uint32_t paramsSlot) {
     // Command buffer begin info
     VkCommandBufferBeginInfo beginInfo{};
     beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
     beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
 
     vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    recordRenderPass(commandBuffer, imageIndex, state, paramsSlot);
+    if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("Failed to record command buffer!");
+    }
+}
 
+// The fragment pass: draws sim state `state` into swapchain image `imageIndex`
+void VulkanManager::recordRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t state, uint32_t paramsSlot) {
     // Start the render pass
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1218,27 +2444,250 @@ void VulkanManager::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t
     vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
 
     // Bind the graphics pipeline
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline);
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipeline.get());
+    VkViewport viewport{0.0f, 0.0f, static_cast<float>(mSwapChainExtent.width), static_cast<float>(mSwapChainExtent.height), 0.0f, 1.0f};
+    VkRect2D scissor{{0, 0}, mSwapChainExtent};
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    // Render the latest sim state, interpolated from the one before it by the scheduler's leftover time
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipelineLayout, 0, 1, &mGraphicsDescriptorSets[state], 0, nullptr);
+    bindFrameParams(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, mGraphicsPipelineLayout, paramsSlot);
 
     // Draw
     vkCmdDraw(commandBuffer, 3, 1, 0, 0);  // Drawing a triangle without a vertex buffer
 
     vkCmdEndRenderPass(commandBuffer);
+}
+
+// The whole frame in one command buffer from the frame context's pool, for single_submit: the
+// solver steps, then the fragment pass, as one frame graph, so the hand-offs between them are
+// barriers instead of semaphores. Recorded per frame, since the step count varies.
+VkCommandBuffer VulkanManager::recordFrameCommandBuffer(FrameContext& frame, uint32_t imageIndex, uint32_t firstState,
+                                                        uint32_t stepCount, uint32_t substeps, bool resetTiles, bool reduce) {
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = frame.commandPool;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate frame command buffer!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+    // Earlier frames' fragment passes on this queue may still be reading the states
+    FrameGraph graph;
+    FrameGraphResources resources = importFrameResources(graph, SOLVER_PRIOR_STAGES | VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT_KHR);
+    uint32_t slot = mFrameIndex;
+    if (resetTiles) {
+        addTileResetPass(graph, resources);
+    }
+    uint32_t state = firstState;
+    bool snapshot = substeps > 1 && stepCount > 0;
+    for (uint32_t step = 0; step < stepCount; ++step) {
+        if (snapshot && step == stepCount - substeps) {
+            addStepSnapshotPass(graph, resources, state);
+        }
+        addSolverStepPasses(graph, resources, state, slot);
+        state = nextSimState(state);
+    }
+    if (snapshot) {
+        addStepRestorePass(graph, resources, previousSimState(state));
+    }
+    if (reduce) {
+        addFieldReducePass(graph, resources, state, slot);
+    }
+    addRenderPass(graph, resources, imageIndex, state, slot);
+    executeFrameGraph(commandBuffer, graph);
 
     if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS) {
-        throw std::runtime_error("Failed to record command buffer!");
+        throw std::runtime_error("Failed to record frame command buffer!");
     }
+    return commandBuffer;
+}
+
+// Submits the frame recorded by recordFrameCommandBuffer on the graphics queue, signalling both
+// timelines at once so the rest of the frame bookkeeping doesn't care which path ran
+void VulkanManager::submitSingleFrame(FrameContext& frame, uint32_t imageIndex, uint32_t firstState, uint32_t stepCount,
+                                      uint32_t substeps, bool resetTiles, bool reduce, uint64_t frameValue) {
+    VkCommandBufferSubmitInfoKHR commandBufferInfo{};
+    commandBufferInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO_KHR;
+    commandBufferInfo.commandBuffer = recordFrameCommandBuffer(frame, imageIndex, firstState, stepCount, substeps, resetTiles, reduce);
+
+    VkSemaphoreSubmitInfoKHR waitInfo{};
+    waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+    waitInfo.semaphore = frame.imageAvailable;
+    waitInfo.stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT_KHR;
+
+    VkSemaphoreSubmitInfoKHR signalInfos[3]{};
+    for (auto& signalInfo : signalInfos) {
+        signalInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO_KHR;
+        signalInfo.stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT_KHR;
+    }
+    signalInfos[0].semaphore = frame.renderFinished;
+    signalInfos[1].semaphore = mSimTimeline;
+    signalInfos[1].value = frameValue;
+    signalInfos[2].semaphore = mRenderTimeline;
+    signalInfos[2].value = frameValue;
+
+    VkSubmitInfo2KHR submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2_KHR;
+    submitInfo.waitSemaphoreInfoCount = 1;
+    submitInfo.pWaitSemaphoreInfos = &waitInfo;
+    submitInfo.commandBufferInfoCount = 1;
+    submitInfo.pCommandBufferInfos = &commandBufferInfo;
+    submitInfo.signalSemaphoreInfoCount = 3;
+    submitInfo.pSignalSemaphoreInfos = signalInfos;
+    if (mQueueSubmit2(mGraphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit frame!");
+    }
+}
+
+// Records every compute command buffer a steady-state frame submits. Only the installed pipelines
+// and the grid size are baked in; per-frame values come from the FrameParams slot each buffer is
+// bound to. The set depends on the kernels, so a new one is recorded whenever they change.
+void VulkanManager::recordFrameComputeCommands() {
+    // Frames in flight may still be running the old set
+    if (mFrameCommands.tileReset != VK_NULL_HANDLE) {
+        std::vector<VkCommandBuffer> commandBuffers = std::move(mFrameCommands.solverSteps);
+        commandBuffers.insert(commandBuffers.end(), mFrameCommands.fieldReduce.begin(), mFrameCommands.fieldReduce.end());
+        commandBuffers.insert(commandBuffers.end(), mFrameCommands.stepSnapshot.begin(), mFrameCommands.stepSnapshot.end());
+        commandBuffers.insert(commandBuffers.end(), mFrameCommands.stepRestore.begin(), mFrameCommands.stepRestore.end());
+        commandBuffers.push_back(mFrameCommands.tileReset);
+        mDeletionQueue.push(mFrameValue, [this, commandBuffers = std::move(commandBuffers)]() {
+            vkFreeCommandBuffers(mDevice, mComputeCommandPool, static_cast<uint32_t>(commandBuffers.size()),
+                                 commandBuffers.data());
+        });
+        mFrameCommands.solverSteps.clear();
+        mFrameCommands.fieldReduce.clear();
+        mFrameCommands.stepSnapshot.clear();
+        mFrameCommands.stepRestore.clear();
+        mFrameCommands.tileReset = VK_NULL_HANDLE;
+    }
+
+    // Every solver step a frame can run, for every frame context and starting state; a frame submits
+    // as many step buffers as it has steps
+    uint32_t stateCount = static_cast<uint32_t>(mSimStates.size());
+    mFrameCommands.solverSteps.resize(MAX_FRAMES_IN_FLIGHT * stateCount);
+    mFrameCommands.fieldReduce.resize(MAX_FRAMES_IN_FLIGHT * stateCount);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = mComputeCommandPool;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(mFrameCommands.solverSteps.size());
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, mFrameCommands.solverSteps.data()) != VK_SUCCESS ||
+        vkAllocateCommandBuffers(mDevice, &allocInfo, mFrameCommands.fieldReduce.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute command buffers!");
+    }
+    // The step copies take no FrameParams, so one of each per state does for every frame context
+    mFrameCommands.stepSnapshot.resize(stateCount);
+    mFrameCommands.stepRestore.resize(stateCount);
+    allocInfo.commandBufferCount = stateCount;
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, mFrameCommands.stepSnapshot.data()) != VK_SUCCESS ||
+        vkAllocateCommandBuffers(mDevice, &allocInfo, mFrameCommands.stepRestore.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute command buffers!");
+    }
+    allocInfo.commandBufferCount = 1;
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, &mFrameCommands.tileReset) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate compute command buffers!");
+    }
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;  // A frame may submit one step several times
+
+    for (uint32_t slot = 0; slot < MAX_FRAMES_IN_FLIGHT; ++slot) {
+        for (uint32_t state = 0; state < stateCount; ++state) {
+            VkCommandBuffer step = mFrameCommands.solverSteps[slot * stateCount + state];
+            vkBeginCommandBuffer(step, &beginInfo);
+            recordComputeOperations(step, state, slot);
+            vkEndCommandBuffer(step);
+
+            VkCommandBuffer reduce = mFrameCommands.fieldReduce[slot * stateCount + state];
+            vkBeginCommandBuffer(reduce, &beginInfo);
+            recordFieldReduce(reduce, state, slot);
+            vkEndCommandBuffer(reduce);
+        }
+    }
+
+    for (uint32_t state = 0; state < stateCount; ++state) {
+        vkBeginCommandBuffer(mFrameCommands.stepSnapshot[state], &beginInfo);
+        recordStepCopy(mFrameCommands.stepSnapshot[state], state, false);
+        vkEndCommandBuffer(mFrameCommands.stepSnapshot[state]);
+
+        vkBeginCommandBuffer(mFrameCommands.stepRestore[state], &beginInfo);
+        recordStepCopy(mFrameCommands.stepRestore[state], state, true);
+        vkEndCommandBuffer(mFrameCommands.stepRestore[state]);
+    }
+
+    vkBeginCommandBuffer(mFrameCommands.tileReset, &beginInfo);
+    recordTileStateReset(mFrameCommands.tileReset);
+    vkEndCommandBuffer(mFrameCommands.tileReset);
+
+    mFrameCommands.computeDirty = false;
+}
+
+// Records the fragment pass for every frame context, swapchain image and sim state to show.
+// The set depends on the swapchain, so a new one is recorded whenever the swapchain changes.
+void VulkanManager::recordFrameRenderCommands() {
+    // Frames in flight may still be running the old set
+    if (!mFrameCommands.render.empty()) {
+        mDeletionQueue.push(mFrameValue, [this, commandBuffers = std::move(mFrameCommands.render)]() {
+            vkFreeCommandBuffers(mDevice, mGraphicsCommandPool, static_cast<uint32_t>(commandBuffers.size()),
+                                 commandBuffers.data());
+        });
+        mFrameCommands.render.clear();
+    }
+
+    uint32_t stateCount = static_cast<uint32_t>(mSimStates.size());
+    uint32_t imageCount = static_cast<uint32_t>(mFramebuffers.size());
+    mFrameCommands.render.resize(MAX_FRAMES_IN_FLIGHT * imageCount * stateCount);
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = mGraphicsCommandPool;
+    allocInfo.commandBufferCount = static_cast<uint32_t>(mFrameCommands.render.size());
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, mFrameCommands.render.data()) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate graphics command buffers!");
+    }
+
+    for (uint32_t slot = 0; slot < MAX_FRAMES_IN_FLIGHT; ++slot) {
+        for (uint32_t image = 0; image < imageCount; ++image) {
+            for (uint32_t state = 0; state < stateCount; ++state) {
+                recordCommandBuffer(mFrameCommands.render[(slot * imageCount + image) * stateCount + state], image, state, slot);
+            }
+        }
+    }
+
+    mFrameCommands.renderDirty = false;
 }
 
 void VulkanManager::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                                  VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                                 VkDeviceMemory& bufferMemory) {
+                                 VkDeviceMemory& bufferMemory, bool sharedWithGraphics) {
     VkBufferCreateInfo bufferInfo{};
     bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
     bufferInfo.size = size;
     bufferInfo.usage = usage;
     bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
 
+    // Buffers the solver writes on its own queue family and the fragment shader reads on the
+    // graphics family are shared concurrently instead of transferring ownership every frame
+    const QueueFamilyIndices& families = mDeviceProfile->queueFamilies;
+    uint32_t queueFamilies[] = {families.computeFamily.value(), families.graphicsFamily.value()};
+    if (sharedWithGraphics && families.crossFamilyCompute()) {
+        bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+        bufferInfo.queueFamilyIndexCount = 2;
+        bufferInfo.pQueueFamilyIndices = queueFamilies;
+    }
+
     if (vkCreateBuffer(mDevice, &bufferInfo, nullptr,
                        &buffer) != VK_SUCCESS) {
         throw std::runtime_error("failed to create buffer!");
@@ -1283,156 +2732,1148 @@ void VulkanManager::createFramebuffers() {
     }
 }
 
+// Each state has room for mGridCapacity cells, so a rotated or slightly resized grid fits in place.
+// Transfer usage lets resampleGrid() copy one state over another. The states start out zeroed:
+// quiet tiles are never written, and the fragment pass and the solver's halo read them as they are.
 void VulkanManager::createShaderBuffers() {
-    // todo: refactor mSwapChainExtent to be mWindowExtent.
-    VkDeviceSize velocitySize = mSwapChainExtent.width * mSwapChainExtent.height * sizeof(float) * 2; // vec2 for each pixel
-    VkDeviceSize pressureSize = mSwapChainExtent.width * mSwapChainExtent.height * sizeof(float); // float for each pixel
+    VkDeviceSize velocitySize = mGridCapacity * sizeof(float) * 2; // vec2 for each cell
+    VkDeviceSize pressureSize = mGridCapacity * sizeof(float); // float for each cell
+    VkBufferUsageFlags usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+
+    // Two states serialize the solver with the fragment pass; every state beyond that lets the
+    // solver run one more frame ahead of it
+    uint32_t pipelineDepth = std::min(mConfig.getUint("sim_pipeline_depth", 1), MAX_SIM_PIPELINE_DEPTH);
+    mSimStates.resize(2 + pipelineDepth);
+    auto zeroFill = [this](VkDeviceMemory memory, VkDeviceSize size) {
+        void* mapped = nullptr;
+        if (vkMapMemory(mDevice, memory, 0, size, 0, &mapped) != VK_SUCCESS) {
+            throw std::runtime_error("failed to map sim state!");
+        }
+        std::memset(mapped, 0, static_cast<size_t>(size));
+        vkUnmapMemory(mDevice, memory);
+    };
+    for (SimState& state : mSimStates) {
+        createBuffer(velocitySize, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, state.velocity, state.velocityMemory, true);
+        createBuffer(pressureSize, usage, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, state.pressure, state.pressureMemory, true);
+        zeroFill(state.velocityMemory, velocitySize);
+        zeroFill(state.pressureMemory, pressureSize);
+    }
+    // Only ever copied to and from on the solver's queue
+    createBuffer(velocitySize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mStepSnapshot.velocity, mStepSnapshot.velocityMemory);
+    createBuffer(pressureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mStepSnapshot.pressure, mStepSnapshot.pressureMemory);
+    mSimState = 0;
+    LOGI("Simulation state ring: %zu states of %llu cells", mSimStates.size(), static_cast<unsigned long long>(mGridCapacity));
+}
 
-    // Create velocity buffer
-    createBuffer(velocitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mVelocityBuffer, mVelocityBufferMemory);
+void VulkanManager::destroySimState(SimState& state) {
+    vkDestroyBuffer(mDevice, state.velocity, nullptr);
+    vkFreeMemory(mDevice, state.velocityMemory, nullptr);
+    vkDestroyBuffer(mDevice, state.pressure, nullptr);
+    vkFreeMemory(mDevice, state.pressureMemory, nullptr);
+    state = SimState{};
+}
 
-    // Create pressure buffer
-    createBuffer(pressureSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mPressureBuffer, mPressureBufferMemory);
+// `count` plus grid_headroom percent (fs20.conf, default 25): room for the grid to change size
+// without reallocating. A quarter turn only transposes the grid, so it always fits.
+VkDeviceSize VulkanManager::withGridHeadroom(VkDeviceSize count) {
+    return count * (100 + mConfig.getUint("grid_headroom", 25)) / 100;
+}
 
-    // Create velocity output buffer
-    createBuffer(velocitySize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mVelocityOutputBuffer, mVelocityOutputBufferMemory);
+// Host-visible so results can be read back without a copy; stays mapped for the app's lifetime.
+void VulkanManager::createFieldStatsBuffer() {
+    VkDeviceSize size = sizeof(FieldStats) * MAX_FRAMES_IN_FLIGHT;
+    createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mFieldStatsBuffer, mFieldStatsBufferMemory);
 
-    // Create pressure output buffer
-    createBuffer(pressureSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mPressureOutputBuffer, mPressureOutputBufferMemory);
+    void* mapped = nullptr;
+    if (vkMapMemory(mDevice, mFieldStatsBufferMemory, 0, size, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map field stats buffer!");
+    }
+    mFieldStats = static_cast<FieldStats*>(mapped);
+    std::memset(mFieldStats, 0, size);
+}
+
+// FrameParams slots followed by the upload ring, mapped for the app's lifetime, so per-frame data
+// reaches the GPU with plain stores: no vkMapMemory or buffer creation per frame
+void VulkanManager::createUploadBuffer() {
+    VkDeviceSize ringAlignment = mDeviceProfile->properties.limits.minStorageBufferOffsetAlignment;
+    mUploadRingBase = (frameParamsStride() * MAX_FRAMES_IN_FLIGHT + ringAlignment - 1) / ringAlignment * ringAlignment;
+    VkDeviceSize size = mUploadRingBase + UPLOAD_RING_SIZE;
+    createBuffer(size, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 mUploadBuffer, mUploadBufferMemory, true);
+
+    void* mapped = nullptr;
+    if (vkMapMemory(mDevice, mUploadBufferMemory, 0, size, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map upload buffer!");
+    }
+    mUploadMapped = static_cast<uint8_t*>(mapped);
+    std::memset(mUploadMapped, 0, size);
+
+    mUploadRing.reset(UPLOAD_RING_SIZE);
+
+    mFrameParamsDescriptorSet = allocateDescriptorSet(mFrameParamsSetLayout);
+    std::array<VkDescriptorBufferInfo, 2> bufferInfos = {{
+            {mUploadBuffer, 0, sizeof(FrameParams)},
+            {mUploadBuffer, mUploadRingBase, UPLOAD_RING_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = mFrameParamsDescriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
+    }
+    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    vkUpdateDescriptorSets(mDevice, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+}
+
+// sizeof(FrameParams) rounded up to minUniformBufferOffsetAlignment
+VkDeviceSize VulkanManager::frameParamsStride() const {
+    VkDeviceSize alignment = mDeviceProfile->properties.limits.minUniformBufferOffsetAlignment;
+    return (sizeof(FrameParams) + alignment - 1) / alignment * alignment;
+}
+
+// Frame context `slot`'s FrameParams
+VulkanManager::FrameParams& VulkanManager::frameParams(uint32_t slot) {
+    return *reinterpret_cast<FrameParams*>(mUploadMapped + mFrameContexts[slot].paramsOffset);
+}
+
+// Binds frame context `slot`'s FrameParams as set 1 of `layout`
+void VulkanManager::bindFrameParams(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t slot) {
+    auto offset = static_cast<uint32_t>(mFrameContexts[slot].paramsOffset);
+    vkCmdBindDescriptorSets(commandBuffer, bindPoint, layout, 1, 1, &mFrameParamsDescriptorSet, 1, &offset);
+}
+
+// Tile flags, the compacted tile list and the indirect dispatch arguments never leave the GPU.
+// Sized for the autotuning candidate with the most tiles on `base`'s grid or its transpose, plus
+// the grid headroom, so any of them can run on these buffers, rotated or not.
+void VulkanManager::createTileBuffers(const ComputeSpecialization& base) {
+    ComputeSpecialization transposed = base;
+    std::swap(transposed.gridWidth, transposed.gridHeight);
+    uint32_t maxTileCount = base.tileCount();
+    for (const ComputeSpecialization& grid : {base, transposed}) {
+        for (const auto& candidate : computeCandidates(grid)) {
+            maxTileCount = std::max(maxTileCount, candidate.tileCount());
+        }
+    }
+    mTileCapacity = static_cast<uint32_t>(withGridHeadroom(maxTileCount));
+
+    VkDeviceSize tileBufferSize = mTileCapacity * sizeof(uint32_t);
+    createBuffer(tileBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mTileFlagsBuffer, mTileFlagsBufferMemory);
+    createBuffer(tileBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mTileListBuffer, mTileListBufferMemory);
+    createBuffer(sizeof(VkDispatchIndirectCommand), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+                 VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mTileArgsBuffer, mTileArgsBufferMemory);
+    mTileStateReset = false;
+
+    LOGI("Active tile map: up to %u tiles", mTileCapacity);
+}
+
+void VulkanManager::destroyTileBuffers() {
+    vkDestroyBuffer(mDevice, mTileFlagsBuffer, nullptr);
+    vkFreeMemory(mDevice, mTileFlagsBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mTileListBuffer, nullptr);
+    vkFreeMemory(mDevice, mTileListBufferMemory, nullptr);
+    vkDestroyBuffer(mDevice, mTileArgsBuffer, nullptr);
+    vkFreeMemory(mDevice, mTileArgsBufferMemory, nullptr);
+}
+
+// The workgroup shapes and unroll factors the autotuner chooses between, restricted to what the
+// device can launch with the selected kernels. The first candidate is the untuned default.
+std::vector<VulkanManager::ComputeSpecialization> VulkanManager::computeCandidates(const ComputeSpecialization& base) {
+    const VkPhysicalDeviceLimits& limits = mDeviceProfile->properties.limits;
+
+    const uint32_t shapes[][2] = {{16, 16}, {8, 8}, {32, 4}, {64, 1}};
+    const uint32_t unrolls[] = {1, 2};
+
+    std::vector<ComputeSpecialization> candidates;
+    for (const auto& shape : shapes) {
+        if (shape[0] > limits.maxComputeWorkGroupSize[0] || shape[1] > limits.maxComputeWorkGroupSize[1] ||
+            shape[0] * shape[1] > limits.maxComputeWorkGroupInvocations) {
+            continue;
+        }
+        for (uint32_t unroll : unrolls) {
+            ComputeSpecialization candidate = base;
+            candidate.localSizeX = shape[0];
+            candidate.localSizeY = shape[1];
+            candidate.unroll = unroll;
+            if (mKernels->sharedTile && candidate.sharedTileBytes() > limits.maxComputeSharedMemorySize) {
+                continue;
+            }
+            candidates.push_back(candidate);
+        }
+    }
+    return candidates;
+}
+
+std::string VulkanManager::computeTuningKey(const ComputeSpecialization& base) const {
+    const VkPhysicalDeviceProperties& properties = mDeviceProfile->properties;
+    return "compute-" + std::to_string(properties.vendorID) + "-" + std::to_string(properties.deviceID) +
+           "-" + std::to_string(properties.driverVersion) + "-" + std::to_string(base.boundaryMode) +
+           "-" + mKernels->name;
+}
+
+// Starts the simulation on the baseline kernels with the default workgroup shape, which compile
+// quickly, and queues the specialized kernels behind them. If this GPU and driver have a persisted
+// tuning result (or autotune=0 in fs20.conf) only that one shape is compiled; otherwise every
+// candidate is, and they are timed against each other over the frames before they swap in.
+void VulkanManager::createProgressiveComputePipelines(const ComputeSpecialization& base) {
+    std::vector<ComputeSpecialization> candidates = computeCandidates(base);
+    if (candidates.empty()) {
+        candidates.push_back(base);
+    }
+
+    const KernelPermutation& generic = kernelPermutations[std::size(kernelPermutations) - 1];
+    installComputePipelines(submitComputePipelines(candidates.front(), generic));
+    if (mKernels == &generic && candidates.size() == 1) {
+        return;  // Nothing better to swap in
+    }
+
+    std::vector<uint32_t> tuned;
+    TuningCache cache(mFilesDir + "/tuning.cache");
+    if (!mConfig.getBool("autotune", true)) {
+        candidates.resize(1);
+    } else if (!mConfig.getBool("retune", false) && cache.lookup(computeTuningKey(base), tuned) && tuned.size() == 3) {
+        for (const auto& candidate : candidates) {
+            if (candidate.localSizeX == tuned[0] && candidate.localSizeY == tuned[1] && candidate.unroll == tuned[2]) {
+                LOGI("Using tuned compute shape %ux%u, unroll %u", tuned[0], tuned[1], tuned[2]);
+                candidates = {candidate};
+                break;
+            }
+        }
+    }
+
+    for (const auto& candidate : candidates) {
+        mComputeUpgrade.push_back(submitComputePipelines(candidate, *mKernels));
+    }
+}
+
+bool VulkanManager::computeUpgradeReady() const {
+    for (const auto& pipelines : mComputeUpgrade) {
+        if (!computePipelinesReady(pipelines)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool VulkanManager::computePipelinesReady(const ComputePipelineSet& pipelines) {
+    return pipelines.solver.ready() && pipelines.tileCompact.ready() && pipelines.reduce.ready();
+}
+
+// Destroys the set once the last frame submitted so far is done with it
+void VulkanManager::retireComputePipelines(const ComputePipelineSet& pipelines) {
+    mDeletionQueue.push(mFrameValue, [this, pipelines]() mutable {
+        destroyPipeline(pipelines.solver);
+        destroyPipeline(pipelines.tileCompact);
+        destroyPipeline(pipelines.reduce);
+    });
+}
+
+// Called by drawFrame() for a frame that will be submitted. Once every queued specialized build
+// has finished, times the candidates one per frame if there is more than one, then swaps the
+// winner in. Nothing here waits for the GPU.
+void VulkanManager::updateComputeUpgrade(FrameContext& frame, uint64_t frameValue) {
+    if (mComputeUpgrade.empty() || !computeUpgradeReady()) {
+        return;
+    }
+    if (mComputeUpgrade.size() == 1) {
+        applyComputeUpgrade(0);
+        return;
+    }
+
+    if (mAutotune.queryPool == VK_NULL_HANDLE) {
+        if (mDeviceProfile->computeTimestampValidBits() == 0) {
+            LOGI("Compute queue has no timestamps, skipping autotuning");
+            applyComputeUpgrade(0);
+            return;
+        }
+        createComputeAutotune();
+    }
+    if (mAutotune.submitted < mComputeUpgrade.size()) {
+        submitAutotuneCandidate(frame, mAutotune.submitted++, frameValue);
+        return;
+    }
+
+    size_t best;
+    if (finishComputeAutotune(best)) {
+        const ComputeSpecialization& tuned = mComputeUpgrade[best].specialization;
+        TuningCache cache(mFilesDir + "/tuning.cache");
+        cache.store(computeTuningKey(tuned), {tuned.localSizeX, tuned.localSizeY, tuned.unroll});
+        applyComputeUpgrade(best);
+    }
+}
+
+// Replaces the installed kernels with candidate `best`. Frames in flight (and the autotuning
+// submits) may still be using the kernels it replaces and the other candidates, so those are
+// retired rather than destroyed.
+void VulkanManager::applyComputeUpgrade(size_t best) {
+    retireComputePipelines({mComputeSpecialization, mKernels, mComputePipeline, mTileCompactPipeline, mReducePipeline});
+    for (size_t i = 0; i < mComputeUpgrade.size(); ++i) {
+        if (i != best) {
+            retireComputePipelines(mComputeUpgrade[i]);
+        }
+    }
+    installComputePipelines(mComputeUpgrade[best]);
+    mComputeUpgrade.clear();
+
+    // The tile size may have changed, so the tile flags no longer line up with the tiles
+    mTileStateReset = false;
+    mPipelineCacheSaved = false;
+}
+
+// Scratch buffers for timing the candidates on the current grid: two states, tile flags, a list of
+// every tile and, per candidate, indirect arguments dispatching all of its tiles
+void VulkanManager::createComputeAutotune() {
+    const ComputeSpecialization& grid = mComputeUpgrade.front().specialization;
+    VkDeviceSize cellCount = static_cast<VkDeviceSize>(grid.gridWidth) * grid.gridHeight;
+    uint32_t maxTileCount = 0;
+    for (const auto& candidate : mComputeUpgrade) {
+        maxTileCount = std::max(maxTileCount, candidate.specialization.tileCount());
+    }
+
+    VkBufferUsageFlags stateUsage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+    for (SimState& state : mAutotune.states) {
+        createBuffer(cellCount * sizeof(float) * 2, stateUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, state.velocity, state.velocityMemory);
+        createBuffer(cellCount * sizeof(float), stateUsage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, state.pressure, state.pressureMemory);
+    }
+    VkDeviceSize tileBufferSize = maxTileCount * sizeof(uint32_t);
+    VkDeviceSize argsSize = mComputeUpgrade.size() * sizeof(VkDispatchIndirectCommand);
+    createBuffer(tileBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, mAutotune.tileFlags, mAutotune.tileFlagsMemory);
+    createBuffer(tileBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                 mAutotune.tileList, mAutotune.tileListMemory);
+    createBuffer(argsSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+                 VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, mAutotune.tileArgs, mAutotune.tileArgsMemory);
+
+    // Host writes are visible to every later submit, so the graph doesn't track these two
+    void* mapped = nullptr;
+    if (vkMapMemory(mDevice, mAutotune.tileListMemory, 0, tileBufferSize, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map autotuning tile list!");
+    }
+    auto* tiles = static_cast<uint32_t*>(mapped);
+    for (uint32_t tile = 0; tile < maxTileCount; ++tile) {
+        tiles[tile] = tile;
+    }
+    vkUnmapMemory(mDevice, mAutotune.tileListMemory);
+
+    if (vkMapMemory(mDevice, mAutotune.tileArgsMemory, 0, argsSize, 0, &mapped) != VK_SUCCESS) {
+        throw std::runtime_error("failed to map autotuning arguments!");
+    }
+    auto* args = static_cast<VkDispatchIndirectCommand*>(mapped);
+    for (size_t i = 0; i < mComputeUpgrade.size(); ++i) {
+        args[i] = {mComputeUpgrade[i].specialization.tileCount(), 1, 1};
+    }
+    vkUnmapMemory(mDevice, mAutotune.tileArgsMemory);
+
+    VkQueryPoolCreateInfo queryPoolInfo{};
+    queryPoolInfo.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+    queryPoolInfo.queryType = VK_QUERY_TYPE_TIMESTAMP;
+    queryPoolInfo.queryCount = static_cast<uint32_t>(mComputeUpgrade.size() * 2);
+    if (vkCreateQueryPool(mDevice, &queryPoolInfo, nullptr, &mAutotune.queryPool) != VK_SUCCESS) {
+        throw std::runtime_error("failed to create timestamp query pool!");
+    }
+    mAutotune.submitted = 0;
+}
+
+// Times candidate `candidate` of mComputeUpgrade: one untimed warm-up step, then AUTOTUNE_STEPS
+// steps, every one over all tiles, the worst case the tile map allows. Submitted to the solver's
+// queue ahead of this frame's steps, so the frame holds up for one candidate at most. The states
+// are cleared first so every candidate starts from the same field.
+void VulkanManager::submitAutotuneCandidate(FrameContext& frame, size_t candidate, uint64_t frameValue) {
+    ComputePipelineSet& pipelines = mComputeUpgrade[candidate];
+    VkPipeline solver = pipelines.solver.get();  // Built already, doesn't block
+
+    // Set k steps scratch state k into the other one
+    std::array<VkDescriptorSet, 2> descriptorSets{};
+    for (uint32_t state = 0; state < 2; ++state) {
+        const SimState& input = mAutotune.states[state];
+        const SimState& output = mAutotune.states[1 - state];
+        descriptorSets[state] = allocateFrameDescriptorSet(frame, mDescriptorSetLayout);
+        writeStorageBufferSet(descriptorSets[state], {
+                {input.velocity, 0, VK_WHOLE_SIZE},
+                {input.pressure, 0, VK_WHOLE_SIZE},
+                {output.velocity, 0, VK_WHOLE_SIZE},
+                {output.pressure, 0, VK_WHOLE_SIZE},
+                {mAutotune.tileList, 0, VK_WHOLE_SIZE},
+                {mAutotune.tileFlags, 0, VK_WHOLE_SIZE},
+        });
+    }
+
+    // The frame contexts' FrameParams slots belong to frames in flight; these come from the ring
+    UploadAllocation upload = uploadAllocate(sizeof(FrameParams), mDeviceProfile->properties.limits.minUniformBufferOffsetAlignment);
+    FrameParams params{mSimScheduler.stepSize(), 0.1f, 0u, 0u, 0.0f,
+                       static_cast<int32_t>(pipelines.specialization.gridWidth),
+                       static_cast<int32_t>(pipelines.specialization.gridHeight)};
+    std::memcpy(upload.data, &params, sizeof(FrameParams));
+    auto paramsOffset = static_cast<uint32_t>(mUploadRingBase + upload.offset);
+
+    // The previous candidate's submit on this queue used the same buffers
+    FrameGraph graph;
+    FrameGraph::Access prior{SOLVER_PRIOR_STAGES, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR | VK_ACCESS_2_SHADER_WRITE_BIT_KHR};
+    std::array<FrameGraph::ResourceId, 2> states = {graph.importBuffer("autotune state 0", prior),
+                                                    graph.importBuffer("autotune state 1", prior)};
+    FrameGraph::ResourceId tileFlags = graph.importBuffer("autotune tile flags", prior);
+
+    graph.addPass("autotune clear", [this](VkCommandBuffer commandBuffer) {
+                vkCmdFillBuffer(commandBuffer, mAutotune.states[0].velocity, 0, VK_WHOLE_SIZE, 0);
+                vkCmdFillBuffer(commandBuffer, mAutotune.states[0].pressure, 0, VK_WHOLE_SIZE, 0);
+            })
+            .writes(states[0], VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+
+    VkQueryPool queryPool = mAutotune.queryPool;
+    auto firstQuery = static_cast<uint32_t>(candidate * 2);
+    VkDeviceSize argsOffset = candidate * sizeof(VkDispatchIndirectCommand);
+    for (uint32_t step = 0; step <= AUTOTUNE_STEPS; ++step) {
+        if (step == 1) {
+            graph.addPass("autotune start", [queryPool, firstQuery](VkCommandBuffer commandBuffer) {
+                        vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, firstQuery);
+                    })
+                    .hasSideEffects();
+        }
+        uint32_t state = step & 1;
+        graph.addPass("autotune step", [this, solver, descriptorSet = descriptorSets[state], paramsOffset, argsOffset](VkCommandBuffer commandBuffer) {
+                    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, solver);
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+                    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mComputePipelineLayout, 1, 1, &mFrameParamsDescriptorSet, 1, &paramsOffset);
+                    vkCmdDispatchIndirect(commandBuffer, mAutotune.tileArgs, argsOffset);
+                })
+                .reads(states[state], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+                .writes(states[1 - state], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR)
+                .writes(tileFlags, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR);
+    }
+    graph.addPass("autotune end", [queryPool, firstQuery](VkCommandBuffer commandBuffer) {
+                vkCmdWriteTimestamp(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, queryPool, firstQuery + 1);
+            })
+            .hasSideEffects();
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = mComputeCommandPool;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate autotuning command buffer!");
+    }
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    vkCmdResetQueryPool(commandBuffer, queryPool, firstQuery, 2);
+    executeFrameGraph(commandBuffer, graph);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkQueueSubmit(mComputeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit autotuning steps!");
+    }
+    // This frame's solver submit follows on the same queue, so the buffer is done when the frame is
+    mDeletionQueue.push(frameValue, [this, commandBuffer]() {
+        vkFreeCommandBuffers(mDevice, mComputeCommandPool, 1, &commandBuffer);
+    });
+}
+
+// Polls the timestamps of every candidate submitted; once they are all in, sets `best` to the
+// fastest and retires the scratch buffers. Returns false while the GPU is still timing.
+bool VulkanManager::finishComputeAutotune(size_t& best) {
+    auto queryCount = static_cast<uint32_t>(mComputeUpgrade.size() * 2);
+    std::vector<uint64_t> timestamps(queryCount);
+    if (vkGetQueryPoolResults(mDevice, mAutotune.queryPool, 0, queryCount, timestamps.size() * sizeof(uint64_t),
+                              timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) != VK_SUCCESS) {
+        return false;
+    }
+
+    uint32_t timestampValidBits = mDeviceProfile->computeTimestampValidBits();
+    uint64_t timestampMask = timestampValidBits >= 64 ? ~0ull : (1ull << timestampValidBits) - 1;
+    best = 0;
+    double bestMs = 0.0;
+    for (size_t i = 0; i < mComputeUpgrade.size(); ++i) {
+        const ComputeSpecialization& candidate = mComputeUpgrade[i].specialization;
+        double ms = static_cast<double>((timestamps[i * 2 + 1] - timestamps[i * 2]) & timestampMask) * mDeviceProfile->properties.limits.timestampPeriod / 1e6;
+        LOGI("Autotune %ux%u unroll %u: %.3f ms per step", candidate.localSizeX, candidate.localSizeY,
+             candidate.unroll, ms / AUTOTUNE_STEPS);
+        if (i == 0 || ms < bestMs) {
+            best = i;
+            bestMs = ms;
+        }
+    }
+
+    // Every candidate's submit went ahead of a frame submitted by now
+    mDeletionQueue.push(mFrameValue, [this, autotune = mAutotune]() mutable {
+        destroyComputeAutotune(autotune);
+    });
+    mAutotune = ComputeAutotune{};
+
+    const ComputeSpecialization& tuned = mComputeUpgrade[best].specialization;
+    LOGI("Autotune picked %ux%u, unroll %u", tuned.localSizeX, tuned.localSizeY, tuned.unroll);
+    return true;
+}
+
+void VulkanManager::destroyComputeAutotune(ComputeAutotune& autotune) {
+    for (SimState& state : autotune.states) {
+        destroySimState(state);
+    }
+    vkDestroyBuffer(mDevice, autotune.tileFlags, nullptr);
+    vkFreeMemory(mDevice, autotune.tileFlagsMemory, nullptr);
+    vkDestroyBuffer(mDevice, autotune.tileList, nullptr);
+    vkFreeMemory(mDevice, autotune.tileListMemory, nullptr);
+    vkDestroyBuffer(mDevice, autotune.tileArgs, nullptr);
+    vkFreeMemory(mDevice, autotune.tileArgsMemory, nullptr);
+    vkDestroyQueryPool(mDevice, autotune.queryPool, nullptr);
+    autotune = ComputeAutotune{};
+}
+
+// Clockwise quarter turns the presentation engine applies for `transform`; mirrored transforms
+// count by their rotation alone
+uint32_t VulkanManager::surfaceQuarterTurns(VkSurfaceTransformFlagBitsKHR transform) {
+    switch (transform) {
+        case VK_SURFACE_TRANSFORM_ROTATE_90_BIT_KHR:
+        case VK_SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_90_BIT_KHR:
+            return 1;
+        case VK_SURFACE_TRANSFORM_ROTATE_180_BIT_KHR:
+        case VK_SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_180_BIT_KHR:
+            return 2;
+        case VK_SURFACE_TRANSFORM_ROTATE_270_BIT_KHR:
+        case VK_SURFACE_TRANSFORM_HORIZONTAL_MIRROR_ROTATE_270_BIT_KHR:
+            return 3;
+        default:
+            return 0;
+    }
+}
+
+// Called with a new swapchain in place. The grid is to follow the new extent, its content turned
+// back by however far the surface rotated, so the smoke stays where it was on the glass. Takes
+// effect in updateGridResize(); a resize still pending is folded into this one.
+void VulkanManager::requestGridResize(VkExtent2D previousExtent, VkSurfaceTransformFlagBitsKHR previousTransform) {
+    uint32_t turns = (surfaceQuarterTurns(previousTransform) + 4 - surfaceQuarterTurns(mSwapChainTransform)) & 3;
+    bool transposed = (previousExtent.width > previousExtent.height) != (mSwapChainExtent.width > mSwapChainExtent.height);
+    if ((turns & 1) != (transposed ? 1u : 0u)) {
+        // The reported transform doesn't match how the extent changed; trust the extent
+        turns = transposed ? 1 : 0;
+    }
+
+    uint32_t width = mSwapChainExtent.width;
+    uint32_t height = mSwapChainExtent.height;
+    if (mGridResize.pipelinesSubmitted && (width != mGridResize.width || height != mGridResize.height)) {
+        retireComputePipelines(mGridResize.pipelines);  // Built for a size the surface no longer has
+        mGridResize.pipelines = ComputePipelineSet{};
+        mGridResize.pipelinesSubmitted = false;
+    }
+    mGridResize.width = width;
+    mGridResize.height = height;
+    mGridResize.quarterTurns = (mGridResize.quarterTurns + turns) & 3;
+    mGridResize.pending = mGridResize.quarterTurns != 0 || width != mComputeSpecialization.gridWidth ||
+                          height != mComputeSpecialization.gridHeight;
+    if (!mGridResize.pending) {
+        mGridResize = GridResize{};  // Back where the grid already is
+        return;
+    }
+
+    // A settled field would otherwise keep the old grid until the next touch
+    std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+    mSimIdle = false;
+}
+
+// Called by drawFrame() for a frame that will be submitted. Starts building the solver for the new
+// grid on the worker pool if the size changed, and resamples once it (and the resample kernel) is
+// ready; until then frames keep running the old grid.
+void VulkanManager::updateGridResize(FrameContext& frame, uint64_t frameValue) {
+    // Specialized kernels still compiling for the current grid swap in first
+    if (!mGridResize.pending || !mComputeUpgrade.empty() || !mResamplePipeline.ready()) {
+        return;
+    }
+    bool gridChanged = mGridResize.width != mComputeSpecialization.gridWidth ||
+                       mGridResize.height != mComputeSpecialization.gridHeight;
+    if (gridChanged && !mGridResize.pipelinesSubmitted) {
+        // Same kernels and workgroup shape, only the grid differs
+        ComputeSpecialization specialization = mComputeSpecialization;
+        specialization.gridWidth = mGridResize.width;
+        specialization.gridHeight = mGridResize.height;
+        mGridResize.pipelines = submitComputePipelines(specialization, *mKernels);
+        mGridResize.pipelinesSubmitted = true;
+    }
+    if (gridChanged && !computePipelinesReady(mGridResize.pipelines)) {
+        return;
+    }
+    resampleGrid(frame, frameValue);
+}
+
+// Carries the latest state over to the pending grid with one resample dispatch, submitted to the
+// solver's queue ahead of this frame. The result goes to the next state in the ring and is copied
+// over every other state, so the fragment pass never interpolates between two grids and no quiet
+// tile keeps the old grid in a state it reaches later. Within the grid
+// capacity nothing is reallocated and the CPU never waits; past it the states (and if need be the
+// tile buffers) are recreated with the device idle, since every descriptor set points at them.
+void VulkanManager::resampleGrid(FrameContext& frame, uint64_t frameValue) {
+    bool gridChanged = mGridResize.pipelinesSubmitted;  // Only submitted for a new size
+    ComputeSpecialization next = gridChanged ? mGridResize.pipelines.specialization : mComputeSpecialization;
+    VkDeviceSize cellCount = static_cast<VkDeviceSize>(next.gridWidth) * next.gridHeight;
+    ResamplePushConstantData resampleData{
+            static_cast<int32_t>(mComputeSpecialization.gridWidth), static_cast<int32_t>(mComputeSpecialization.gridHeight),
+            static_cast<int32_t>(next.gridWidth), static_cast<int32_t>(next.gridHeight), mGridResize.quarterTurns};
+
+    SimState source = mSimStates[mSimState];
+    bool reallocate = cellCount > mGridCapacity || next.tileCount() > mTileCapacity;
+    if (reallocate) {
+        vkDeviceWaitIdle(mDevice);
+        for (uint32_t state = 0; state < mSimStates.size(); ++state) {
+            if (state != mSimState) {
+                destroySimState(mSimStates[state]);
+            }
+        }
+        mSimStates[mSimState] = SimState{};  // Still the resample's source; retired below
+        destroySimState(mStepSnapshot);
+        mGridCapacity = withGridHeadroom(cellCount);
+        createShaderBuffers();
+        if (next.tileCount() > mTileCapacity) {
+            destroyTileBuffers();
+            createTileBuffers(next);
+        }
+        setupComputeDescriptorSet();
+        setupGraphicsDescriptorSets();
+        setupReduceDescriptorSets();
+        setupTileCompactDescriptorSet();
+        mFrameCommands.computeDirty = true;
+        mFrameCommands.renderDirty = true;
+        mDeletionQueue.push(frameValue, [this, source]() mutable {
+            destroySimState(source);
+        });
+    }
+
+    uint32_t target = nextSimState(mSimState);
+    uint32_t latest = mSimState;
+    // Every state is overwritten, so fragment passes still reading any of them have to finish first
+    uint64_t releaseValue = 0;
+    for (const SimState& state : mSimStates) {
+        releaseValue = std::max(releaseValue, state.lastRenderValue);
+    }
+
+    VkDescriptorSet descriptorSet = allocateFrameDescriptorSet(frame, mResampleDescriptorSetLayout);
+    writeStorageBufferSet(descriptorSet, {
+            {source.velocity, 0, VK_WHOLE_SIZE},
+            {source.pressure, 0, VK_WHOLE_SIZE},
+            {mSimStates[target].velocity, 0, VK_WHOLE_SIZE},
+            {mSimStates[target].pressure, 0, VK_WHOLE_SIZE},
+    });
+
+    FrameGraph graph;
+    FrameGraphResources resources = importFrameResources(graph, SOLVER_PRIOR_STAGES);
+    FrameGraph::ResourceId sourceState = resources.states[latest];
+    if (reallocate) {
+        sourceState = graph.importBuffer("retired sim state", {SOLVER_PRIOR_STAGES, VK_ACCESS_2_SHADER_WRITE_BIT_KHR});
+    }
+    graph.addPass("grid resample", [this, descriptorSet, resampleData](VkCommandBuffer commandBuffer) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mResamplePipeline.get());
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, mResamplePipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
+                vkCmdPushConstants(commandBuffer, mResamplePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(ResamplePushConstantData), &resampleData);
+                vkCmdDispatch(commandBuffer, static_cast<uint32_t>(resampleData.dstWidth + 7) / 8,
+                              static_cast<uint32_t>(resampleData.dstHeight + 7) / 8, 1);
+            })
+            .reads(sourceState, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_READ_BIT_KHR)
+            .writes(resources.states[target], VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR, VK_ACCESS_2_SHADER_WRITE_BIT_KHR);
+    FrameGraph::PassBuilder copyPass = graph.addPass("grid copy", [this, target, cellCount](VkCommandBuffer commandBuffer) {
+                VkBufferCopy velocityCopy{0, 0, cellCount * sizeof(float) * 2};
+                VkBufferCopy pressureCopy{0, 0, cellCount * sizeof(float)};
+                for (uint32_t state = 0; state < mSimStates.size(); ++state) {
+                    if (state != target) {
+                        vkCmdCopyBuffer(commandBuffer, mSimStates[target].velocity, mSimStates[state].velocity, 1, &velocityCopy);
+                        vkCmdCopyBuffer(commandBuffer, mSimStates[target].pressure, mSimStates[state].pressure, 1, &pressureCopy);
+                    }
+                }
+            });
+    copyPass.reads(resources.states[target], VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_READ_BIT_KHR);
+    for (uint32_t state = 0; state < mSimStates.size(); ++state) {
+        if (state != target) {
+            copyPass.writes(resources.states[state], VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR, VK_ACCESS_2_TRANSFER_WRITE_BIT_KHR);
+        }
+    }
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    allocInfo.commandPool = mComputeCommandPool;
+    allocInfo.commandBufferCount = 1;
+    VkCommandBuffer commandBuffer;
+    if (vkAllocateCommandBuffers(mDevice, &allocInfo, &commandBuffer) != VK_SUCCESS) {
+        throw std::runtime_error("failed to allocate resample command buffer!");
+    }
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(commandBuffer, &beginInfo);
+    executeFrameGraph(commandBuffer, graph);
+    vkEndCommandBuffer(commandBuffer);
+
+    VkTimelineSemaphoreSubmitInfo timelineInfo{};
+    timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+    timelineInfo.waitSemaphoreValueCount = 1;
+    timelineInfo.pWaitSemaphoreValues = &releaseValue;
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.pNext = &timelineInfo;
+    VkPipelineStageFlags waitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+    submitInfo.waitSemaphoreCount = 1;
+    submitInfo.pWaitSemaphores = &mRenderTimeline;
+    submitInfo.pWaitDstStageMask = &waitStage;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &commandBuffer;
+    if (vkQueueSubmit(mComputeQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS) {
+        throw std::runtime_error("failed to submit grid resample!");
+    }
+    // This frame's solver submit follows on the same queue, so the buffer is done when the frame is
+    mDeletionQueue.push(frameValue, [this, commandBuffer]() {
+        vkFreeCommandBuffers(mDevice, mComputeCommandPool, 1, &commandBuffer);
+    });
+
+    mSimState = target;
+    if (gridChanged) {
+        retireComputePipelines({mComputeSpecialization, mKernels, mComputePipeline, mTileCompactPipeline, mReducePipeline});
+        installComputePipelines(mGridResize.pipelines);
+    }
+    // The tile flags describe the old grid
+    mTileStateReset = false;
+
+    LOGI("Grid resampled to %ux%u, %u quarter turns%s", next.gridWidth, next.gridHeight, resampleData.quarterTurns,
+         reallocate ? ", reallocated" : "");
+    mGridResize = GridResize{};
 }
 
 // Let's let JNI call this so the app can pause and resume, lifecycle etc.
-void VulkanManager::drawFrame(float delta, float x, float y, bool isTouching) {
-    static int currentFrame = 0;
+void VulkanManager::drawFrame(float delta, const std::vector<glm::vec2>& splats, bool isTouching) {
+    uint32_t currentFrame = mFrameIndex;
 
-    LOGI("x=%f y=%f ",x,y);
-    // Wait for the previous frame to finish
-    vkWaitForFences(mDevice, 1, &mInFlightFences[currentFrame], VK_TRUE, UINT64_MAX);
+    // Waits for the fragment pass of the frame that last used this context, which itself waited
+    // for its solver submit
+    FrameContext& frame = beginFrame();
+    uint64_t frameValue = mFrameValue + 1;
+
+    // This frame context's last reduction is complete now; pick up its max |u| for the CFL limit
+    // and its activity for quiescence detection
+    bool hasNewStats = readFieldStats(currentFrame);
+    updateQuiescence(hasNewStats, isTouching);
 
     uint32_t imageIndex;
-    VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, mImageAvailableSemaphores[currentFrame], VK_NULL_HANDLE, &imageIndex);
+    VkResult result = vkAcquireNextImageKHR(mDevice, mSwapChain, UINT64_MAX, frame.imageAvailable, VK_NULL_HANDLE, &imageIndex);
 
-    if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
-        // Handle swapchain recreation
+    if (result == VK_ERROR_OUT_OF_DATE_KHR) {
+        // Nothing was acquired; the next frame draws to the new swapchain
         recreateSwapChain();
         return;
-    } else if (result != VK_SUCCESS) {
+    } else if (result != VK_SUCCESS && result != VK_SUBOPTIMAL_KHR) {
         throw std::runtime_error("Failed to acquire swap chain image!");
     }
-
-    if (mImagesInFlight[imageIndex] != VK_NULL_HANDLE) {
-        vkWaitForFences(mDevice, 1, &mImagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+    // A suboptimal image has been acquired and its semaphore will be signalled, so it is still
+    // drawn and presented; the swapchain is replaced after that
+    bool swapChainStale = result == VK_SUBOPTIMAL_KHR;
+
+    // The image may come back before the frame that last rendered into it has finished
+    waitTimeline(mRenderTimeline, mImagePresentValues[imageIndex]);
+    mImagePresentValues[imageIndex] = frameValue;
+
+    // This frame is submitted now, so autotuning and a pending grid resize can go ahead of its solver
+    updateComputeUpgrade(frame, frameValue);
+    updateGridResize(frame, frameValue);
+
+    // Compute commands are dirty after a pipeline swap, render commands after a new swapchain or
+    // graphics pipeline; both are recorded afresh. A single-submit frame is recorded from scratch
+    // below instead.
+    if (!mSingleSubmit && mFrameCommands.computeDirty) {
+        recordFrameComputeCommands();
+    }
+    if (!mSingleSubmit && mFrameCommands.renderDirty) {
+        recordFrameRenderCommands();
+    }
+
+    // The solver always advances by the scheduler's fixed step, however long the frame took;
+    // the frame time only decides how many steps (possibly none) this frame runs. Each step is
+    // split into CFL substeps from the max |u| read back from an earlier frame.
+    uint32_t steps = mSimScheduler.advance(delta);
+    uint32_t substeps = mSimScheduler.cflSubsteps(mMaxSpeed);
+    float substepSize = mSimScheduler.stepSize() / static_cast<float>(substeps);
+
+    // Everything that changes from frame to frame goes through this context's FrameParams; the
+    // command buffers themselves were recorded up front.
+    // Until a resize has been resampled, the old grid is shown stretched over the new surface.
+    FrameParams& params = frameParams(currentFrame);
+    params.deltaTime = substepSize;
+    params.visc = 0.1f;
+    params.splatOffset = 0;
+    params.splatCount = static_cast<uint32_t>(splats.size());
+    if (!splats.empty()) {
+        UploadAllocation upload = uploadAllocate(splats.size() * sizeof(glm::vec2), sizeof(glm::vec2));
+        std::memcpy(upload.data, splats.data(), splats.size() * sizeof(glm::vec2));
+        params.splatOffset = static_cast<uint32_t>(upload.offset / sizeof(glm::vec2));
+    }
+    params.alpha = mSimScheduler.alpha();
+    params.width = static_cast<int32_t>(mComputeSpecialization.gridWidth);
+    params.height = static_cast<int32_t>(mComputeSpecialization.gridHeight);
+
+    uint32_t stateCount = static_cast<uint32_t>(mSimStates.size());
+    uint32_t firstState = mSimState;
+    uint32_t stepCount = steps * substeps;
+    bool resetTiles = !mTileStateReset;
+    mTileStateReset = true;
+    std::vector<VkCommandBuffer>& computeCommandBuffers = mFrameCommands.computeSubmit;
+    computeCommandBuffers.clear();
+    if (resetTiles && !mSingleSubmit) {
+        computeCommandBuffers.push_back(mFrameCommands.tileReset);
+    }
+    // Each step writes the next state in the ring. A state can only be overwritten once the last
+    // fragment pass that reads it is done; with more states than steps per frame, that pass is
+    // an older frame's and the solver doesn't wait for the frame just submitted.
+    // With substeps, the start of the last full step is saved and put back in the state before the
+    // latest, which the last substeps have already overwritten, so params.alpha stays a fraction of
+    // a whole step.
+    uint64_t releaseValue = 0;
+    bool snapshot = substeps > 1 && steps > 0;
+    for (uint32_t step = 0; step < stepCount; ++step) {
+        if (snapshot && step == stepCount - substeps && !mSingleSubmit) {
+            computeCommandBuffers.push_back(mFrameCommands.stepSnapshot[mSimState]);
+        }
+        if (!mSingleSubmit) {
+            computeCommandBuffers.push_back(mFrameCommands.solverSteps[currentFrame * stateCount + mSimState]);
+        }
+        mSimState = nextSimState(mSimState);
+        releaseValue = std::max(releaseValue, mSimStates[mSimState].lastRenderValue);
+    }
+    if (snapshot && !mSingleSubmit) {
+        computeCommandBuffers.push_back(mFrameCommands.stepRestore[previousSimState(mSimState)]);
+    }
+    if (steps > 0) {
+        if (!mSingleSubmit) {
+            computeCommandBuffers.push_back(mFrameCommands.fieldReduce[currentFrame * stateCount + mSimState]);
+        }
+        mFieldStatsPending[currentFrame] = true;
     }
-    mImagesInFlight[imageIndex] = mInFlightFences[currentFrame];
 
-    // Prepare for compute operations
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    // This frame's fragment pass reads the latest state and the one before it
+    mSimStates[mSimState].lastRenderValue = frameValue;
+    mSimStates[previousSimState(mSimState)].lastRenderValue = frameValue;
 
-    vkResetCommandBuffer(mComputeCommandBuffer, 0);
-    vkBeginCommandBuffer(mComputeCommandBuffer, &beginInfo);
-
-    PushConstantData pcData{delta, 0.1f, static_cast<int>(mSwapChainExtent.width), static_cast<int>(mSwapChainExtent.height), glm::vec2(x, y), isTouching};
-    vkCmdPushConstants(mComputeCommandBuffer, mComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstantData), &pcData);
-    recordComputeOperations(mComputeCommandBuffer, imageIndex);
-    vkEndCommandBuffer(mComputeCommandBuffer);
-
-    VkSubmitInfo computeSubmitInfo{};
-    computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    computeSubmitInfo.commandBufferCount = 1;
-    computeSubmitInfo.pCommandBuffers = &mComputeCommandBuffer;
-    vkQueueSubmit(mComputeQueue, 1, &computeSubmitInfo, mInFlightFences[currentFrame]);
-
-    // Graphics queue submission
-    vkResetCommandBuffer(mCommandBuffers[currentFrame], 0);
-    recordCommandBuffer(mCommandBuffers[currentFrame], imageIndex);
-
-    VkSubmitInfo graphicsSubmitInfo{};
-    graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    VkSemaphore waitSemaphores[] = {mRenderFinishedSemaphores[currentFrame]};
-    VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT};
-    graphicsSubmitInfo.waitSemaphoreCount = 1;
-    graphicsSubmitInfo.pWaitSemaphores = waitSemaphores;
-    graphicsSubmitInfo.pWaitDstStageMask = waitStages;
-    graphicsSubmitInfo.commandBufferCount = 1;
-    graphicsSubmitInfo.pCommandBuffers = &mCommandBuffers[currentFrame];
-    VkSemaphore signalSemaphores[] = {mRenderFinishedSemaphores[currentFrame]};
-    graphicsSubmitInfo.signalSemaphoreCount = 1;
-    graphicsSubmitInfo.pSignalSemaphores = signalSemaphores;
-    vkQueueSubmit(mGraphicsQueue, 1, &graphicsSubmitInfo, mInFlightFences[currentFrame]);
+    if (mSingleSubmit) {
+        submitSingleFrame(frame, imageIndex, firstState, stepCount, substeps, resetTiles, steps > 0, frameValue);
+    } else {
+        // The solver queue only waits for the fragment passes above to let go of the states it
+        // overwrites, not for acquire or present
+        VkTimelineSemaphoreSubmitInfo computeTimelineInfo{};
+        computeTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        computeTimelineInfo.waitSemaphoreValueCount = 1;
+        computeTimelineInfo.pWaitSemaphoreValues = &releaseValue;
+        computeTimelineInfo.signalSemaphoreValueCount = 1;
+        computeTimelineInfo.pSignalSemaphoreValues = &frameValue;
+
+        VkSubmitInfo computeSubmitInfo{};
+        computeSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        computeSubmitInfo.pNext = &computeTimelineInfo;
+        VkPipelineStageFlags computeWaitStage = VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+        computeSubmitInfo.waitSemaphoreCount = 1;
+        computeSubmitInfo.pWaitSemaphores = &mRenderTimeline;
+        computeSubmitInfo.pWaitDstStageMask = &computeWaitStage;
+        computeSubmitInfo.commandBufferCount = static_cast<uint32_t>(computeCommandBuffers.size());
+        computeSubmitInfo.pCommandBuffers = computeCommandBuffers.data();
+        computeSubmitInfo.signalSemaphoreCount = 1;
+        computeSubmitInfo.pSignalSemaphores = &mSimTimeline;
+        vkQueueSubmit(mComputeQueue, 1, &computeSubmitInfo, VK_NULL_HANDLE);
+
+        // Graphics queue submission
+        uint32_t imageCount = static_cast<uint32_t>(mFramebuffers.size());
+        VkCommandBuffer renderCommandBuffer = mFrameCommands.render[(currentFrame * imageCount + imageIndex) * stateCount + mSimState];
+
+        // Only the fragment shader needs the solver's output; the vertex stage and the attachment
+        // clear don't wait for it
+        // Values for binary semaphores are ignored
+        uint64_t waitValues[] = {0, frameValue};
+        uint64_t signalValues[] = {0, frameValue};
+        VkTimelineSemaphoreSubmitInfo graphicsTimelineInfo{};
+        graphicsTimelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        graphicsTimelineInfo.waitSemaphoreValueCount = 2;
+        graphicsTimelineInfo.pWaitSemaphoreValues = waitValues;
+        graphicsTimelineInfo.signalSemaphoreValueCount = 2;
+        graphicsTimelineInfo.pSignalSemaphoreValues = signalValues;
+
+        VkSubmitInfo graphicsSubmitInfo{};
+        graphicsSubmitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        graphicsSubmitInfo.pNext = &graphicsTimelineInfo;
+        VkSemaphore waitSemaphores[] = {frame.imageAvailable, mSimTimeline};
+        VkPipelineStageFlags waitStages[] = {VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT};
+        graphicsSubmitInfo.waitSemaphoreCount = 2;
+        graphicsSubmitInfo.pWaitSemaphores = waitSemaphores;
+        graphicsSubmitInfo.pWaitDstStageMask = waitStages;
+        graphicsSubmitInfo.commandBufferCount = 1;
+        graphicsSubmitInfo.pCommandBuffers = &renderCommandBuffer;
+        VkSemaphore signalSemaphores[] = {frame.renderFinished, mRenderTimeline};
+        graphicsSubmitInfo.signalSemaphoreCount = 2;
+        graphicsSubmitInfo.pSignalSemaphores = signalSemaphores;
+        vkQueueSubmit(mGraphicsQueue, 1, &graphicsSubmitInfo, VK_NULL_HANDLE);
+    }
+    mFrameValue = frameValue;
+    frame.renderValue = frameValue;
+    mUploadRing.endFrame(frameValue);
 
     // Presenting the image
     VkPresentInfoKHR presentInfo{};
     presentInfo.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
     presentInfo.waitSemaphoreCount = 1;
-    presentInfo.pWaitSemaphores = signalSemaphores;
+    presentInfo.pWaitSemaphores = &frame.renderFinished;
     VkSwapchainKHR swapChains[] = {mSwapChain};
     presentInfo.swapchainCount = 1;
     presentInfo.pSwapchains = swapChains;
     presentInfo.pImageIndices = &imageIndex;
-    vkQueuePresentKHR(mPresentQueue, &presentInfo);
+    VkResult presentResult = vkQueuePresentKHR(mPresentQueue, &presentInfo);
+    if (swapChainStale || presentResult == VK_ERROR_OUT_OF_DATE_KHR || presentResult == VK_SUBOPTIMAL_KHR) {
+        recreateSwapChain();
+    }
 
-    currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+    // Every pipeline the first frame needed has been built by now. Save here as well as in
+    // cleanup(): Android often kills the process without tearing down.
+    if (!mPipelineCacheSaved) {
+        savePipelineCache();
+        mPipelineCacheSaved = true;
+    }
+
+    mFrameIndex = (mFrameIndex + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
 
-void VulkanManager::cleanup() {
-    if (mInstance != VK_NULL_HANDLE) {
-        vkDestroyInstance(mInstance, nullptr);
-        mInstance = VK_NULL_HANDLE;
+void VulkanManager::startRenderLoop() {
+    std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+    if (mRenderLoopRunning) {
+        return;
+    }
+    // A loop that stopped itself on an error has exited but hasn't been joined
+    if (mRenderThread.joinable()) {
+        mRenderThread.join();
     }
-    // Clean up other Vulkan resources like device, swapchain, etc.
-    ANativeWindow_release(mWindow);
+    // mRenderLoopPaused is left alone: the activity may already have paused us during init
+    mRenderLoopRunning = true;
+    mRenderThread = std::thread(&VulkanManager::renderLoop, this);
+}
 
-    for (auto framebuffer : mFramebuffers) {
-        vkDestroyFramebuffer(mDevice, framebuffer, nullptr);
+void VulkanManager::stopRenderLoop() {
+    {
+        std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+        mRenderLoopRunning = false;
     }
-    mFramebuffers.clear();
+    mRenderLoopCv.notify_all();
+    // Also joins a loop that already stopped itself on an error
+    if (mRenderThread.joinable()) {
+        mRenderThread.join();
+    }
+}
 
-    for (auto fence : mImagesInFlight) {
-        vkDestroyFence(mDevice, fence, nullptr);
+void VulkanManager::pauseRenderLoop() {
+    std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+    mRenderLoopPaused = true;
+}
+
+void VulkanManager::resumeRenderLoop() {
+    {
+        std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+        mRenderLoopPaused = false;
     }
+    mRenderLoopCv.notify_all();
+}
 
-    for (auto imageView : mSwapChainImageViews) {
-        vkDestroyImageView(mDevice, imageView, nullptr);
+void VulkanManager::updateTouch(float x, float y, bool isTouching) {
+    {
+        std::lock_guard<std::mutex> lock(mTouchMutex);
+        mTouch.x = x;
+        mTouch.y = y;
+        mTouch.isTouching = isTouching;
+        // Moves arrive faster than frames; keep them all so a quick stroke stays continuous
+        if (isTouching) {
+            if (mTouch.samples.size() < MAX_TOUCH_SPLATS) {
+                mTouch.samples.emplace_back(x, y);
+            } else {
+                mTouch.samples.back() = glm::vec2(x, y);
+            }
+        }
     }
-    mSwapChainImageViews.clear();
 
-#ifdef USES_DEPTH_IMAGE_VIEW
-    // If using depth resources, destroy them
-    if (mDepthImageView) {
-        vkDestroyImageView(mDevice, mDepthImageView, nullptr);
-        vkDestroyImage(mDevice, mDepthImage, nullptr);
-        vkFreeMemory(mDevice, mDepthImageMemory, nullptr);
+    if (isTouching) {
+        // Wake a quiescent render loop right away
+        {
+            std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+            mSimIdle = false;
+        }
+        mRenderLoopCv.notify_all();
     }
-#endif
+}
 
-    // Finally, destroy the swapchain
-    vkDestroySwapchainKHR(mDevice, mSwapChain, nullptr);
-    mSwapChain = VK_NULL_HANDLE;
+// Runs on mRenderThread. There is no sleep here: drawFrame blocks on the render timeline and
+// vkAcquireNextImageKHR once FIFO has MAX_FRAMES_IN_FLIGHT images queued, so the loop runs at
+// the display's refresh rate and delta is measured between actual presents.
+void VulkanManager::renderLoop() {
+    LOGI("Native render loop started");
+    auto lastTime = std::chrono::steady_clock::now();
+    std::vector<glm::vec2> splats;  // Swapped with mTouch.samples, so neither reallocates
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mRenderLoopMutex);
+            if (mRenderLoopRunning && (mRenderLoopPaused || mSimIdle)) {
+                // Paused, or the field has settled: no dispatches, no presents until resumed or touched
+                mRenderLoopCv.wait(lock, [this] { return !mRenderLoopRunning || (!mRenderLoopPaused && !mSimIdle); });
+                // Don't feed the time spent asleep into the simulation
+                lastTime = std::chrono::steady_clock::now();
+            }
+            if (!mRenderLoopRunning) {
+                break;
+            }
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        float delta = std::chrono::duration<float>(now - lastTime).count();
+        lastTime = now;
+
+        bool isTouching;
+        {
+            std::lock_guard<std::mutex> lock(mTouchMutex);
+            isTouching = mTouch.isTouching;
+            splats.swap(mTouch.samples);
+            mTouch.samples.clear();
+            // A finger held still sends no moves but keeps pushing smoke
+            if (isTouching && splats.empty()) {
+                splats.emplace_back(mTouch.x, mTouch.y);
+            }
+        }
+
+        try {
+            drawFrame(delta, splats, isTouching);
+        } catch (const std::exception& e) {
+            LOGE("Render loop stopped: %s", e.what());
+            // So the next startRenderLoop(), on a new surface say, starts it again
+            std::lock_guard<std::mutex> lock(mRenderLoopMutex);
+            mRenderLoopRunning = false;
+            break;
+        }
+    }
+
+    vkDeviceWaitIdle(mDevice);
+    LOGI("Native render loop stopped");
+}
+
+// Tears everything down in reverse order of creation: device children, the device, the surface,
+// then the instance
+void VulkanManager::cleanup() {
+    stopRenderLoop();
+    mPipelineWorkers.reset();  // Finishes any build still queued
+
+    if (mDevice != VK_NULL_HANDLE) {
+        vkDeviceWaitIdle(mDevice);
+        mDeletionQueue.flushAll();
+
+        if (mSwapChain != VK_NULL_HANDLE) {
+            cleanupSwapChain();  // Framebuffers, image views and the swapchain
+        }
+        destroyPipeline(mGraphicsPipeline);
+
+        destroyComputePipeline();
+        for (auto& pipelines : mComputeUpgrade) {
+            destroyPipeline(pipelines.solver);
+            destroyPipeline(pipelines.tileCompact);
+            destroyPipeline(pipelines.reduce);
+        }
+        mComputeUpgrade.clear();
+        if (mAutotune.queryPool != VK_NULL_HANDLE) {
+            destroyComputeAutotune(mAutotune);
+        }
+        if (mGridResize.pipelinesSubmitted) {
+            destroyPipeline(mGridResize.pipelines.solver);
+            destroyPipeline(mGridResize.pipelines.tileCompact);
+            destroyPipeline(mGridResize.pipelines.reduce);
+        }
+        mGridResize = GridResize{};
+        destroyPipeline(mResamplePipeline);
+
+        if (mPipelineCache != VK_NULL_HANDLE) {
+            savePipelineCache();
+            vkDestroyPipelineCache(mDevice, mPipelineCache, nullptr);
+            mPipelineCache = VK_NULL_HANDLE;
+        }
+
+        vkDestroyPipelineLayout(mDevice, mComputePipelineLayout, nullptr);
+        vkDestroyPipelineLayout(mDevice, mGraphicsPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(mDevice, mReducePipelineLayout, nullptr);
+        vkDestroyPipelineLayout(mDevice, mTileCompactPipelineLayout, nullptr);
+        vkDestroyPipelineLayout(mDevice, mResamplePipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mGraphicsDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mReduceDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mTileCompactDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mResampleDescriptorSetLayout, nullptr);
+        vkDestroyDescriptorSetLayout(mDevice, mFrameParamsSetLayout, nullptr);
+        vkDestroyDescriptorPool(mDevice, mDescriptorPool, nullptr);  // Frees the persistent sets
+        vkDestroyRenderPass(mDevice, mRenderPass, nullptr);
+
+        for (SimState& state : mSimStates) {
+            destroySimState(state);
+        }
+        mSimStates.clear();
+        destroySimState(mStepSnapshot);
+
+        vkDestroyBuffer(mDevice, mFieldStatsBuffer, nullptr);
+        vkFreeMemory(mDevice, mFieldStatsBufferMemory, nullptr);  // Implicitly unmaps mFieldStats
+        mFieldStats = nullptr;
 
-    vkDestroyBuffer(mDevice, mVelocityBuffer, nullptr);
-    vkFreeMemory(mDevice, mVelocityBufferMemory, nullptr);
+        vkDestroyBuffer(mDevice, mUploadBuffer, nullptr);
+        vkFreeMemory(mDevice, mUploadBufferMemory, nullptr);  // Implicitly unmaps mUploadMapped
+        mUploadMapped = nullptr;
 
-    vkDestroyBuffer(mDevice, mPressureBuffer, nullptr);
-    vkFreeMemory(mDevice, mPressureBufferMemory, nullptr);
+        destroyTileBuffers();
 
-    vkDestroyBuffer(mDevice, mVelocityOutputBuffer, nullptr);
-    vkFreeMemory(mDevice, mVelocityOutputBufferMemory, nullptr);
+        vkDestroyImage(mDevice, mTextureImage, nullptr);
+        vkFreeMemory(mDevice, mTextureImageMemory, nullptr);
+
+        for (FrameContext& frame : mFrameContexts) {
+            vkDestroyCommandPool(mDevice, frame.commandPool, nullptr);
+            vkDestroyDescriptorPool(mDevice, frame.descriptorPool, nullptr);
+            vkDestroySemaphore(mDevice, frame.imageAvailable, nullptr);
+            vkDestroySemaphore(mDevice, frame.renderFinished, nullptr);
+        }
+        mFrameContexts.clear();
+        vkDestroySemaphore(mDevice, mSimTimeline, nullptr);
+        vkDestroySemaphore(mDevice, mRenderTimeline, nullptr);
+        mSimTimeline = VK_NULL_HANDLE;
+        mRenderTimeline = VK_NULL_HANDLE;
+
+        vkDestroyCommandPool(mDevice, mComputeCommandPool, nullptr);  // Frees the command buffers too
+        vkDestroyCommandPool(mDevice, mGraphicsCommandPool, nullptr);
+        mFrameCommands = FrameCommands{};
+
+        vkDestroyDevice(mDevice, nullptr);
+        mDevice = VK_NULL_HANDLE;
+    }
 
-    vkDestroyBuffer(mDevice, mPressureOutputBuffer, nullptr);
-    vkFreeMemory(mDevice, mPressureOutputBufferMemory, nullptr);
+    if (mSurface != VK_NULL_HANDLE) {
+        vkDestroySurfaceKHR(mInstance, mSurface, nullptr);
+        mSurface = VK_NULL_HANDLE;
+    }
+    if (mInstance != VK_NULL_HANDLE) {
+        vkDestroyInstance(mInstance, nullptr);
+        mInstance = VK_NULL_HANDLE;
+    }
+    if (mWindow != nullptr) {
+        ANativeWindow_release(mWindow);
+        mWindow = nullptr;
+    }
 
+    // Runs on the UI thread through the cleanup JNI call, which is a Java thread and stays attached
     JNIEnv* env;
     mJvm->AttachCurrentThread(&env, nullptr);
     env->DeleteGlobalRef(mActivity);  // Clean up global reference
-    mJvm->DetachCurrentThread();
 
 }
 
-void VulkanManager::notifyClient() {
+void VulkanManager::notifyClient(float firstFrameMs, float readyMs) {
     JNIEnv* env = nullptr;
-    // Attach the current thread to the JVM to obtain a valid JNIEnv pointer
+    // Only called on the init thread, which is already attached and detaches itself once it is done;
+    // attaching again just returns its JNIEnv
     if (mJvm->AttachCurrentThread(&env, nullptr) != JNI_OK) {
         return; // Failed to attach the thread
     }
@@ -1440,65 +3881,77 @@ void VulkanManager::notifyClient() {
     // Get the MainActivity class
     jclass clazz = env->FindClass("com/aniviza/fingersmoke20/MainActivity");
     if (clazz == nullptr) {
-        mJvm->DetachCurrentThread();
         return; // Class not found
     }
 
-    // Get the ID of the method that starts the rendering loop
-    jmethodID methodId = env->GetMethodID(clazz, "startRenderLoop", "()V");
+    // Get the ID of the method that is told Vulkan is ready
+    jmethodID methodId = env->GetMethodID(clazz, "onVulkanReady", "(FF)V");
     if (methodId == nullptr) {
-        mJvm->DetachCurrentThread();
         return; // Method not found
     }
 
     // Find the global reference to the MainActivity object
     // Assuming 'mainActivityObj' is globally stored during initialization
     if (mActivity == nullptr) {
-        mJvm->DetachCurrentThread();
         return; // Object reference not found
     }
 
     // Call the Java method
-    env->CallVoidMethod(mActivity, methodId);
-
-    // Clean up and detach from the thread
-    mJvm->DetachCurrentThread();
+    env->CallVoidMethod(mActivity, methodId, static_cast<jfloat>(firstFrameMs), static_cast<jfloat>(readyMs));
 }
-/*
-void VulkanManager::updateTouch(float x, float y, bool isTouching) {
-    PushConstantData pcData{};
-    pcData.deltaTime = calculateDeltaTime(); // Implement this based on your timing logic
-    pcData.visc = 0.1f; // Example viscosity value
-    pcData.width = mSwapChainExtent.width;
-    pcData.height = mSwapChainExtent.height;
-    pcData.touchPos = glm::vec2(x, y);
-    pcData.isTouching = isTouching;
-    vkCmdPushConstants(mComputeCommandBuffer, mComputePipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(touch), touch);
-}
-*/
 
 // JNI
 
 static JavaVM* jvm;
 JNIEXPORT jint JNI_OnLoad(JavaVM* vm, void* reserved) {
+    libraryLoadTime = std::chrono::steady_clock::now();
     jvm = vm;
     return JNI_VERSION_1_6;
 }
 
 extern "C" JNIEXPORT void JNICALL
-Java_com_aniviza_fingersmoke20_MainActivity_initVulkan(JNIEnv* env, jobject mainActivity, jobject surface) {
+Java_com_aniviza_fingersmoke20_MainActivity_initVulkan(JNIEnv* env, jobject mainActivity, jobject surface, jstring filesDir) {
     jobject globalActivityRef = env->NewGlobalRef(mainActivity);  // Create a global reference to the MainActivity object
 
     jobject globalSurface = env->NewGlobalRef(surface); // Create a global reference to keep the surface
 
-    std::thread initThread([globalActivityRef, globalSurface]() {
+    // Config and tuning results live in the app's private files directory
+    const char* filesDirChars = env->GetStringUTFChars(filesDir, nullptr);
+    std::string filesDirPath(filesDirChars);
+    env->ReleaseStringUTFChars(filesDir, filesDirChars);
+
+    uint64_t generation;
+    {
+        std::lock_guard<std::mutex> lock(surfaceMutex);
+        generation = ++surfaceGeneration;
+    }
+
+    std::thread initThread([globalActivityRef, globalSurface, filesDirPath, generation]() {
         JNIEnv* newEnv;
         jvm->AttachCurrentThread(&newEnv, nullptr); // Attach the thread to get a valid JNIEnv
 
+        std::lock_guard<std::mutex> lock(surfaceMutex);
+        if (generation != surfaceGeneration) {
+            LOGI("Surface released before it was attached, skipping it");
+            newEnv->DeleteGlobalRef(globalActivityRef);
+            newEnv->DeleteGlobalRef(globalSurface);
+            jvm->DetachCurrentThread();
+            return;
+        }
+
         ANativeWindow *window = ANativeWindow_fromSurface(newEnv, globalSurface);
         if (vkManager == nullptr) {
-            vkManager = new VulkanManager(jvm,globalActivityRef,window); // Initialize Vulkan
-            vkManager->initVulkan();
+            vkManager = new VulkanManager(jvm,globalActivityRef,window,filesDirPath); // Initialize Vulkan
+            if (vkManager->initVulkan() == 0) {
+                vkManager->startRenderLoop();
+            }
+        } else {
+            // Device and simulation survived the last surface; only the window is new
+            try {
+                vkManager->attachSurface(window, globalActivityRef);
+            } catch (const std::exception& e) {
+                LOGE("Failed to attach surface: %s", e.what());
+            }
         }
 
         newEnv->DeleteGlobalRef(globalSurface); // Cleanup global reference
@@ -1508,13 +3961,40 @@ Java_com_aniviza_fingersmoke20_MainActivity_initVulkan(JNIEnv* env, jobject main
 }
 
 extern "C" JNIEXPORT void JNICALL
-Java_com_aniviza_fingersmoke20_MainActivity_drawFrame(JNIEnv* env, jobject obj, jfloat delta, jfloat x, jfloat y, jboolean isTouching) {
+Java_com_aniviza_fingersmoke20_MainActivity_updateTouch(JNIEnv* env, jobject obj, jfloat x, jfloat y, jboolean isTouching) {
     if (vkManager != nullptr) {
-        vkManager->drawFrame(delta, x, y, isTouching);
+        vkManager->updateTouch(x, y, isTouching);
     }
 }
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_aniviza_fingersmoke20_MainActivity_pauseRenderLoop(JNIEnv*, jobject) {
+    if (vkManager != nullptr) {
+        vkManager->pauseRenderLoop();
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_aniviza_fingersmoke20_MainActivity_resumeRenderLoop(JNIEnv*, jobject) {
+    if (vkManager != nullptr) {
+        vkManager->resumeRenderLoop();
+    }
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_com_aniviza_fingersmoke20_MainActivity_releaseSurface(JNIEnv*, jobject) {
+    // Waits out an init or attach still running on the surface, which must not be used past here
+    std::lock_guard<std::mutex> lock(surfaceMutex);
+    ++surfaceGeneration;
+    if (vkManager != nullptr) {
+        vkManager->releaseSurface();
+    }
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_com_aniviza_fingersmoke20_MainActivity_cleanup(JNIEnv*, jobject) {
+    std::lock_guard<std::mutex> lock(surfaceMutex);
+    ++surfaceGeneration;
     if (vkManager != nullptr) {
         delete vkManager;
         vkManager = nullptr;  // Reset the pointer after deletion to avoid dangling pointer issues
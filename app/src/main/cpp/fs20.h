@@ -11,21 +11,68 @@
 #include <vulkan/vulkan.h>
 #include <vulkan/vulkan_android.h>
 #include <Vertex.h>
+#include <SimScheduler.h>
+#include <EngineConfig.h>
+#include <TuningCache.h>
+#include <ThreadPool.h>
+#include <UploadRing.h>
+#include <FrameGraph.h>
+#include <DeletionQueue.h>
+#include <EmbeddedShaders.h>
 #include <iostream>
 #include <iomanip>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <set>
+#include <map>
 #include <string>
+#include <cstring>
+#include <cstddef>
 #include <optional>
 #include <fstream>
 #include <stdexcept>
 #include <array>
 #include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <memory>
+#include <future>
+#include <functional>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdio>
 
 #define MAX_FRAMES_IN_FLIGHT 2
 
+// Per-frame resources: the upload ring all frames in flight share, and how many transient
+// descriptor sets each frame context's descriptor pool holds
+#define UPLOAD_RING_SIZE (64u * 1024u)
+#define FRAME_DESCRIPTOR_SETS 8u
+
+#define MAX_TOUCH_SPLATS 32u  // Touch samples kept per frame; a faster stroke keeps only the latest
+
+// Quiescence: once kinetic energy + pressure mass stays below the threshold for this many field
+// readbacks with nobody touching, the render loop stops dispatching and presenting until input.
+#define QUIESCENCE_THRESHOLD 0.5f
+#define QUIESCENT_READBACKS_TO_SLEEP 30
+#define FIELD_STATS_FIXED_POINT_SCALE 1024.0f  // Must match FIXED_POINT_SCALE in field_reduce.glsl
+
+#define AUTOTUNE_STEPS 8  // Timed solver steps per autotuning candidate
+
+// Device selection micro-benchmark: solver steps over a square grid, all tiles active
+#define DEVICE_BENCHMARK_GRID 512
+#define DEVICE_BENCHMARK_STEPS 32
+
+#define MAX_SIM_PIPELINE_DEPTH 4u  // Extra sim states beyond the two a serialized solver needs
+
+// What the solver's queue may still be doing to a buffer when a separately recorded frame graph
+// starts: tile resets, solver and reduction dispatches, indirect argument reads
+#define SOLVER_PRIOR_STAGES (VK_PIPELINE_STAGE_2_TRANSFER_BIT_KHR | VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT_KHR | \
+                             VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT_KHR)
+
 
 #define LOG_TAG "VulkanManager"
 #define LOGI(...) __android_log_print(ANDROID_LOG_INFO, LOG_TAG, __VA_ARGS__)
@@ -34,14 +81,17 @@
 
 class VulkanManager {
 public:
-    VulkanManager(JavaVM* jvm, jobject activityRef, ANativeWindow* window);
+    VulkanManager(JavaVM* jvm, jobject activityRef, ANativeWindow* window, const std::string& filesDir);
     ~VulkanManager();
 
     int initVulkan();
+    int initDevice();
+    int initPresentation();
+    void initSimulation();
+    void releaseSurface();
+    void attachSurface(ANativeWindow* window, jobject activityRef);
     void cleanup();
 
-    VkPhysicalDevice pickSuitableDevice(const std::vector<VkPhysicalDevice>& devices,
-                                        const std::vector<const char*>& requiredExtensions);
     bool checkDeviceExtensionSupport(VkPhysicalDevice device,
                                                     const std::vector<const char*>& requiredExtensions);
     void createLogicalDevice(const std::vector<const char*>& requiredExtensions);
@@ -55,6 +105,17 @@ public:
         std::optional<uint32_t> computeFamily;
         std::optional<uint32_t> transferFamily;
         std::optional<uint32_t> sparseBindingFamily;
+        uint32_t computeQueueIndex = 0;  // 1 when the solver has a second queue in the graphics family
+
+        // The solver runs on its own queue rather than the graphics queue
+        bool asyncCompute() const {
+            return computeFamily != graphicsFamily || computeQueueIndex != 0;
+        }
+
+        // The sim buffers must change queue family ownership between solver and fragment shader
+        bool crossFamilyCompute() const {
+            return computeFamily != graphicsFamily;
+        }
 
         bool isComplete() const {
             return graphicsFamily.has_value() && presentFamily.has_value();
@@ -66,19 +127,166 @@ public:
 
     QueueFamilyIndices findQueueFamilies(VkPhysicalDevice device, VkSurfaceKHR surface);
 
+    // Everything the engine needs to know about the GPU. Queried once per device by
+    // queryDeviceProfile() while pickSuitableDevice() chooses one, read-only afterwards.
+    struct DeviceProfile {
+        VkPhysicalDeviceProperties properties{};
+        VkPhysicalDeviceMemoryProperties memoryProperties{};
+        QueueFamilyIndices queueFamilies;
+        std::vector<VkQueueFamilyProperties> queueFamilyProperties;
+
+        uint32_t subgroupSize = 1;
+        VkShaderStageFlags subgroupStages = 0;
+        VkSubgroupFeatureFlags subgroupOperations = 0;
+        bool shaderFloat16 = false;
+        bool shaderInt8 = false;
+        bool synchronization2 = false;  // VK_KHR_synchronization2 supported and its feature available
+
+        uint32_t computeTimestampValidBits() const {
+            return queueFamilyProperties[queueFamilies.computeFamily.value()].timestampValidBits;
+        }
+    };
+
+    // A set of solver and reduction kernels compiled with particular permutation defines, and
+    // what the device needs to run it
+    struct KernelPermutation {
+        const char* name;
+        const char* solverShader;
+        const char* reduceShader;
+        bool needsSubgroupReduce;  // USE_SUBGROUP_REDUCE in field_reduce.glsl
+        bool needsFloat16;         // USE_FP16 in compute_shader.glsl
+        bool sharedTile;           // USE_SHARED_TILE in compute_shader.glsl
+    };
+
+    // Specialization constants shared by the solver, tile compaction and field reduction
+    // pipelines (constant_id = field order). The solver only updates tiles that hold smoke (or
+    // border a tile that does); a tile is one solver workgroup's footprint, so its cost follows
+    // the smoke's area rather than the screen's.
+    struct ComputeSpecialization {
+        static constexpr uint32_t BOUNDARY_ZERO = 0;  // Walls: boundary cells held at zero
+        static constexpr uint32_t BOUNDARY_WRAP = 1;  // Periodic
+
+        uint32_t localSizeX = 16;
+        uint32_t localSizeY = 16;
+        uint32_t gridWidth = 0;
+        uint32_t gridHeight = 0;
+        uint32_t boundaryMode = BOUNDARY_ZERO;
+        uint32_t unroll = 1;  // Cells per invocation along x
+        uint32_t quietPasses = 1;  // Passes a tile stays scheduled once quiet: one less than the sim states
+
+        uint32_t tileWidth() const { return localSizeX * unroll; }
+        uint32_t tileHeight() const { return localSizeY; }
+        uint32_t tilesX() const { return (gridWidth + tileWidth() - 1) / tileWidth(); }
+        uint32_t tilesY() const { return (gridHeight + tileHeight() - 1) / tileHeight(); }
+        uint32_t tileCount() const { return tilesX() * tilesY(); }
+        // Shared memory the USE_SHARED_TILE solver needs: the tile plus a one-cell halo of
+        // velocity (vec2) and pressure (float), and the tile activity flag
+        uint32_t sharedTileBytes() const {
+            return static_cast<uint32_t>((tileWidth() + 2) * (tileHeight() + 2) * (2 * sizeof(float) + sizeof(float)) + sizeof(uint32_t));
+        }
+    };
+
+    // A pipeline compiling on mPipelineWorkers. get() blocks only until the first build completes,
+    // so a pipeline costs the caller nothing until the frame that first binds it.
+    struct PendingPipeline {
+        std::shared_future<VkPipeline> build;
+        VkPipeline handle = VK_NULL_HANDLE;
+
+        VkPipeline get() {
+            if (handle == VK_NULL_HANDLE && build.valid()) {
+                handle = build.get();
+            }
+            return handle;
+        }
+
+        // get() won't block
+        bool ready() const {
+            return !build.valid() || build.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+        }
+    };
+
+    // The solver, tile compaction and field reduction pipelines for one specialization
+    struct ComputePipelineSet {
+        ComputeSpecialization specialization;
+        const KernelPermutation* kernels;
+        PendingPipeline solver;
+        PendingPipeline tileCompact;
+        PendingPipeline reduce;
+    };
+
+    VkPhysicalDevice pickSuitableDevice(const std::vector<VkPhysicalDevice>& devices,
+                                        const std::vector<const char*>& requiredExtensions, DeviceProfile& profile);
+    DeviceProfile queryDeviceProfile(VkPhysicalDevice device);
+    void logDeviceProfile(const DeviceProfile& profile);
+    bool supportsKernelPermutation(const KernelPermutation& permutation) const;
+    const KernelPermutation& selectKernelPermutation();
+    uint32_t benchmarkPhysicalDevice(VkPhysicalDevice physicalDevice, const DeviceProfile& profile);
+
     struct SwapChainSupportDetails {
         VkSurfaceCapabilitiesKHR capabilities;
         std::vector<VkSurfaceFormatKHR> formats;
         std::vector<VkPresentModeKHR> presentModes;
     };
 
-    struct PushConstantData {
+    // Everything about a frame that changes from frame to frame. The solver, tile compaction and
+    // fragment shader read it from a fixed slot per frame context, so the command buffers that
+    // bind it can be recorded once; variable-sized data goes through the upload ring, found by
+    // the offsets in here. Must match FrameParams (std140) in the shaders.
+    struct FrameParams {
         float deltaTime;
         float visc;
-        int width;
-        int height;
-        glm::vec2 touchPos;
-        bool isTouching;
+        uint32_t splatOffset;  // First touch splat, in glm::vec2s from the start of the upload ring
+        uint32_t splatCount;   // Zero when nobody is touching
+        float alpha;           // Interpolation factor between the previous and current sim state
+        int32_t width;
+        int32_t height;
+    };
+
+    // Everything one frame in flight owns. Contexts are used round-robin; beginFrame() waits for
+    // the frame that last used a context, after which all of it is reset wholesale rather than
+    // object by object.
+    struct FrameContext {
+        VkCommandPool commandPool = VK_NULL_HANDLE;        // Graphics family, transient
+        VkDescriptorPool descriptorPool = VK_NULL_HANDLE;  // Transient sets, see allocateFrameDescriptorSet()
+        VkSemaphore imageAvailable = VK_NULL_HANDLE;
+        VkSemaphore renderFinished = VK_NULL_HANDLE;
+        uint64_t renderValue = 0;       // mRenderTimeline value of the last frame that used the context
+        VkDeviceSize paramsOffset = 0;  // The context's FrameParams in mUploadBuffer
+    };
+
+    // The buffers the solver and the fragment pass share, as imported into one FrameGraph
+    struct FrameGraphResources {
+        FrameGraph::ResourceId tileFlags;
+        FrameGraph::ResourceId tileList;
+        FrameGraph::ResourceId tileArgs;
+        FrameGraph::ResourceId fieldStats;
+        FrameGraph::ResourceId stepSnapshot;
+        std::vector<FrameGraph::ResourceId> states;  // Velocity and pressure of each sim state
+    };
+
+    struct UploadAllocation {
+        VkDeviceSize offset;  // From the start of the upload ring
+        void* data;
+    };
+
+    struct ReducePushConstantData {
+        uint32_t slot;      // Which frame-in-flight slot of mFieldStatsBuffer to fold into
+    };
+
+    // Must match Params in resample.glsl
+    struct ResamplePushConstantData {
+        int32_t srcWidth;
+        int32_t srcHeight;
+        int32_t dstWidth;
+        int32_t dstHeight;
+        uint32_t quarterTurns;  // Clockwise quarter turns of the content, old grid to new
+    };
+
+    // Must match FieldStats in field_reduce.glsl
+    struct FieldStats {
+        uint32_t maxSpeedBits;   // Bit pattern of max |u| as a float
+        uint32_t kineticEnergy;  // Fixed point, FIELD_STATS_FIXED_POINT_SCALE
+        uint32_t pressureMass;   // Fixed point, FIELD_STATS_FIXED_POINT_SCALE
     };
 
 
@@ -88,31 +296,105 @@ public:
     VkExtent2D chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabilities, VkExtent2D actualExtent);
     void createSwapChain();
     void cleanupSwapChain();
+    void retireSwapChain();
     void recreateSwapChain();
     VkExtent2D getWindowExtent();
+    VkResult createSurface();
+    void createRenderPass();
     void createGraphicsPipeline();
-    void createComputePipeline();
+    VkPipeline buildGraphicsPipeline(VkRenderPass renderPass);
+    void createPipelineCache();
+    void savePipelineCache();
+    PendingPipeline submitPipelineBuild(std::function<VkPipeline()> build);
+    void destroyPipeline(PendingPipeline& pipeline);
+    ComputePipelineSet submitComputePipelines(const ComputeSpecialization& specialization, const KernelPermutation& kernels);
+    void installComputePipelines(const ComputePipelineSet& pipelines);
+    void destroyComputePipeline();
+    std::vector<ComputeSpecialization> computeCandidates(const ComputeSpecialization& base);
+    std::string computeTuningKey(const ComputeSpecialization& base) const;
+    void createProgressiveComputePipelines(const ComputeSpecialization& base);
+    bool computeUpgradeReady() const;
+    static bool computePipelinesReady(const ComputePipelineSet& pipelines);
+    void retireComputePipelines(const ComputePipelineSet& pipelines);
+    void updateComputeUpgrade(FrameContext& frame, uint64_t frameValue);
+    void applyComputeUpgrade(size_t best);
+    VkDescriptorSetLayout createStorageBufferSetLayout(uint32_t bindingCount, VkShaderStageFlags stageFlags);
+    VkPipelineLayout createPipelineLayoutFor(const std::vector<VkDescriptorSetLayout>& setLayouts,
+                                             VkShaderStageFlags stageFlags, uint32_t pushConstantSize = 0);
+    static const std::array<VkSpecializationMapEntry, 7>& computeSpecializationMapEntries();
+    VkPipeline createComputePipelineFromShader(const std::string& shaderName, VkPipelineLayout layout,
+                                               const ComputeSpecialization* specialization = nullptr);
+    VkDescriptorSet allocateDescriptorSet(VkDescriptorSetLayout setLayout);
+    void writeStorageBufferSet(VkDescriptorSet descriptorSet, const std::vector<VkDescriptorBufferInfo>& bufferInfos);
+    void createFieldStatsBuffer();
+    void setupReduceDescriptorSets();
+    void createTileBuffers(const ComputeSpecialization& base);
+    void destroyTileBuffers();
+    void setupTileCompactDescriptorSet();
+    void recordTileStateReset(VkCommandBuffer commandBuffer);
+    void recordFieldReduce(VkCommandBuffer commandBuffer, uint32_t state, uint32_t slot);
+    bool readFieldStats(uint32_t slot);
+    void updateQuiescence(bool hasNewStats, bool isTouching);
     void setupComputeDescriptorSet();
-    std::vector<char> readFile(const std::string& filename);
-    VkShaderModule createShaderModule(const std::vector<char>& code);
+    void setupGraphicsDescriptorSets();
+    VkShaderModule createShaderModule(const std::string& shaderName);
     void createSharedTexture();
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
-    void initVulkanFences();
-    void initSynchronization();
+    static uint32_t findMemoryType(const VkPhysicalDeviceMemoryProperties& memProperties, uint32_t typeFilter,
+                                   VkMemoryPropertyFlags properties);
     void initSemaphores();
-    void initImagesInFlight();
-    void recordComputeOperations(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+    void waitTimeline(VkSemaphore timeline, uint64_t value);
+    void createFrameContexts();
+    FrameContext& beginFrame();
+    UploadAllocation uploadAllocate(VkDeviceSize size, VkDeviceSize alignment);
+    VkDescriptorSet allocateFrameDescriptorSet(FrameContext& frame, VkDescriptorSetLayout setLayout);
+    void createDescriptorPool();
+    void createUploadBuffer();
+    VkDeviceSize frameParamsStride() const;
+    FrameParams& frameParams(uint32_t slot);
+    void bindFrameParams(VkCommandBuffer commandBuffer, VkPipelineBindPoint bindPoint, VkPipelineLayout layout, uint32_t slot);
+    void recordComputeOperations(VkCommandBuffer commandBuffer, uint32_t state, uint32_t paramsSlot);
+    FrameGraphResources importFrameResources(FrameGraph& graph, VkPipelineStageFlags2KHR priorStages);
+    void addTileResetPass(FrameGraph& graph, const FrameGraphResources& resources);
+    void addSolverStepPasses(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state, uint32_t paramsSlot);
+    void addFieldReducePass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state, uint32_t slot);
+    void addStepSnapshotPass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state);
+    void addStepRestorePass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t state);
+    void recordStepCopy(VkCommandBuffer commandBuffer, uint32_t state, bool restore);
+    void addRenderPass(FrameGraph& graph, const FrameGraphResources& resources, uint32_t imageIndex, uint32_t state, uint32_t paramsSlot);
+    void executeFrameGraph(VkCommandBuffer commandBuffer, FrameGraph& graph);
+    void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t state, uint32_t paramsSlot);
+    void recordRenderPass(VkCommandBuffer commandBuffer, uint32_t imageIndex, uint32_t state, uint32_t paramsSlot);
+    VkCommandBuffer recordFrameCommandBuffer(FrameContext& frame, uint32_t imageIndex, uint32_t firstState,
+                                             uint32_t stepCount, uint32_t substeps, bool resetTiles, bool reduce);
+    void submitSingleFrame(FrameContext& frame, uint32_t imageIndex, uint32_t firstState, uint32_t stepCount,
+                           uint32_t substeps, bool resetTiles, bool reduce, uint64_t frameValue);
+    void recordFrameComputeCommands();
+    void recordFrameRenderCommands();
     void createCommandBufferForCompute();
+    void createGraphicsCommandPool();
+    void presentClearFrame();
     void createFramebuffers();
     void updateTouch(float x, float y, bool isTouching);
     void createPipelineLayout();
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
                                      VkMemoryPropertyFlags properties,
                                      VkBuffer& buffer,
-                                     VkDeviceMemory& bufferMemory);
+                                     VkDeviceMemory& bufferMemory,
+                                     bool sharedWithGraphics = false);
     void createShaderBuffers();
-    void drawFrame(float delta, float x, float y, bool isTouching);
+    VkDeviceSize withGridHeadroom(VkDeviceSize count);
+    static uint32_t surfaceQuarterTurns(VkSurfaceTransformFlagBitsKHR transform);
+    void requestGridResize(VkExtent2D previousExtent, VkSurfaceTransformFlagBitsKHR previousTransform);
+    void updateGridResize(FrameContext& frame, uint64_t frameValue);
+    void resampleGrid(FrameContext& frame, uint64_t frameValue);
+    void drawFrame(float delta, const std::vector<glm::vec2>& splats, bool isTouching);
+
+    // Native render loop; replaces the Java sleep/poll thread
+    void startRenderLoop();
+    void stopRenderLoop();
+    void pauseRenderLoop();
+    void resumeRenderLoop();
     std::vector<const char*> getValidationLayers();
     VkResult checkLayerSupport();
     bool isLayerAvailable(const char* layerName,
@@ -122,62 +404,219 @@ public:
     void checkDeviceProperties(VkPhysicalDevice mPhysicalDevice, VkSurfaceKHR mSurface);
 
 private:
-    ANativeWindow* mWindow;
+    ANativeWindow* mWindow;  // Owned reference; null while the app has no surface
     VkInstance mInstance;
-    VkSurfaceKHR mSurface;
+    VkSurfaceKHR mSurface = VK_NULL_HANDLE;
     VkDebugUtilsMessengerEXT mDebugMessenger;
     VkPhysicalDevice mPhysicalDevice;
-    VkDevice mDevice;
+    std::unique_ptr<const DeviceProfile> mDeviceProfile;
+    const KernelPermutation* mKernels = nullptr;  // Selected from the device profile at init
+    VkDevice mDevice = VK_NULL_HANDLE;
 
     VkQueue mGraphicsQueue;
     VkQueue mPresentQueue;
     VkQueue mComputeQueue;
 
-    VkSwapchainKHR mSwapChain;
+    VkSwapchainKHR mSwapChain = VK_NULL_HANDLE;
     VkExtent2D mSwapChainExtent;
     std::vector<VkImage> mSwapChainImages;
     std::vector<VkImageView> mSwapChainImageViews;
     VkFormat mSwapChainImageFormat;
     uint32_t mSwapChainImageCount;
-
-    VkRenderPass mRenderPass;
-    VkPipeline mGraphicsPipeline;
-
-    VkPipeline mComputePipeline;
-    VkPipelineLayout mComputePipelineLayout;
-
-    VkImage mTextureImage; // to share between compute and fragment
-
-    std::vector<VkFence> mInFlightFences;
-    std::vector<VkFence> mImagesInFlight;
-    std::vector<VkSemaphore> mImageAvailableSemaphores;
-    std::vector<VkSemaphore> mRenderFinishedSemaphores;
-
-    std::vector<VkCommandBuffer> mCommandBuffers;
-    VkCommandBuffer mComputeCommandBuffer;
-    VkCommandPool mComputeCommandPool;
-
-    VkDescriptorSetLayout mDescriptorSetLayout;
-    VkDescriptorPool mDescriptorPool;
-    VkDescriptorSet mDescriptorSet;
+    VkSurfaceTransformFlagBitsKHR mSwapChainTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR;
+
+    VkRenderPass mRenderPass = VK_NULL_HANDLE;
+    PendingPipeline mGraphicsPipeline;
+    VkPipelineCache mPipelineCache = VK_NULL_HANDLE;  // Shared by every pipeline, persisted in pipeline.cache
+    bool mPipelineCacheSaved = false;
+    std::unique_ptr<ThreadPool> mPipelineWorkers;  // Compiles pipelines off the init and render threads
+    VkPipelineLayout mGraphicsPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mGraphicsDescriptorSetLayout = VK_NULL_HANDLE;
+
+    PendingPipeline mComputePipeline;
+    VkPipelineLayout mComputePipelineLayout = VK_NULL_HANDLE;
+    ComputeSpecialization mComputeSpecialization;
+    // Specialized kernels compiling while the generic ones run; swapped in by drawFrame once all are
+    // built and, if there are several, timed against each other
+    std::vector<ComputePipelineSet> mComputeUpgrade;
+
+    // Field statistics reduction (max |u| for the CFL limit), read back without stalling:
+    // slot N is written by frame N and read once the frame reusing slot N has waited for it.
+    PendingPipeline mReducePipeline;
+    VkPipelineLayout mReducePipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mReduceDescriptorSetLayout = VK_NULL_HANDLE;
+    std::vector<VkDescriptorSet> mReduceDescriptorSets;  // Indexed by sim state
+    VkBuffer mFieldStatsBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory mFieldStatsBufferMemory = VK_NULL_HANDLE;
+    FieldStats* mFieldStats = nullptr;  // Persistently mapped, MAX_FRAMES_IN_FLIGHT slots
+    std::array<bool, MAX_FRAMES_IN_FLIGHT> mFieldStatsPending{};
+    float mMaxSpeed = 0.0f;  // Latest max |u| read back, in grid cells per second
+    float mActivity = 0.0f;  // Latest kinetic energy + pressure mass read back
+    uint32_t mQuiescentReadbacks = 0;
+
+    // Active tiles: the solver writes a per-tile flag, tile_compact.glsl dilates the flags by one
+    // tile and appends the survivors to the list, and every solver pass and the field reduction
+    // are dispatched indirectly over that list.
+    PendingPipeline mTileCompactPipeline;
+    VkPipelineLayout mTileCompactPipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mTileCompactDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet mTileCompactDescriptorSet = VK_NULL_HANDLE;
+    VkBuffer mTileFlagsBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory mTileFlagsBufferMemory = VK_NULL_HANDLE;
+    VkBuffer mTileListBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory mTileListBufferMemory = VK_NULL_HANDLE;
+    VkBuffer mTileArgsBuffer = VK_NULL_HANDLE;  // VkDispatchIndirectCommand
+    VkDeviceMemory mTileArgsBufferMemory = VK_NULL_HANDLE;
+    bool mTileStateReset = false;  // Flags and args are initialised on the GPU by the first frame
+    uint32_t mTileCapacity = 0;    // Tiles the flags and list have room for
+
+    VkImage mTextureImage = VK_NULL_HANDLE; // to share between compute and fragment
+    VkDeviceMemory mTextureImageMemory = VK_NULL_HANDLE;
+
+    std::vector<FrameContext> mFrameContexts;  // MAX_FRAMES_IN_FLIGHT of them
+    uint32_t mFrameIndex = 0;                  // Context the next frame uses
+    // Frame N's solver submit signals mSimTimeline to N, its fragment pass mRenderTimeline to N.
+    // The CPU waits on exact values instead of per-slot fences.
+    VkSemaphore mSimTimeline = VK_NULL_HANDLE;
+    VkSemaphore mRenderTimeline = VK_NULL_HANDLE;
+    uint64_t mFrameValue = 0;                   // Last frame submitted
+    std::vector<uint64_t> mImagePresentValues;  // Frame last presented from each swapchain image
+    DeletionQueue mDeletionQueue;  // Keyed by render timeline value, flushed by beginFrame()
+    PFN_vkWaitSemaphoresKHR mWaitSemaphores = nullptr;
+
+    // single_submit=1 in fs20.conf: each frame is recorded into one command buffer, solver and
+    // fragment pass separated by a barrier, and goes to the graphics queue in one vkQueueSubmit2.
+    // Needs synchronization2 and the solver sharing the graphics queue.
+    bool mSingleSubmit = false;
+    PFN_vkQueueSubmit2KHR mQueueSubmit2 = nullptr;
+    PFN_vkCmdPipelineBarrier2KHR mCmdPipelineBarrier2 = nullptr;
+
+    VkCommandPool mComputeCommandPool = VK_NULL_HANDLE;
+    VkCommandPool mGraphicsCommandPool = VK_NULL_HANDLE;
+
+    // The steady-state frame, recorded once and then only submitted. A frame picks its buffers by
+    // frame context (whose FrameParams they read), sim state and swapchain image. The compute
+    // ones are recorded anew when the installed kernels change, the render ones when the swapchain
+    // or graphics pipeline changes; either way the old set is retired through mDeletionQueue.
+    struct FrameCommands {
+        std::vector<VkCommandBuffer> solverSteps;  // [slot][state]: one solver step from `state`
+        std::vector<VkCommandBuffer> fieldReduce;  // [slot][state]: reduce `state` into FieldStats slot `slot`
+        std::vector<VkCommandBuffer> render;       // [slot][image][state]
+        std::vector<VkCommandBuffer> stepSnapshot;  // [state]: copy `state` into mStepSnapshot
+        std::vector<VkCommandBuffer> stepRestore;   // [state]: copy mStepSnapshot over `state`
+        VkCommandBuffer tileReset = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> computeSubmit;  // Filled by drawFrame() each frame, kept to reuse its storage
+        bool computeDirty = true;
+        bool renderDirty = true;
+    } mFrameCommands;
+
+    // Persistently mapped: one FrameParams slot per frame context, then the upload ring
+    VkBuffer mUploadBuffer = VK_NULL_HANDLE;
+    VkDeviceMemory mUploadBufferMemory = VK_NULL_HANDLE;
+    uint8_t* mUploadMapped = nullptr;
+    VkDeviceSize mUploadRingBase = 0;  // Where the ring starts in mUploadBuffer
+    UploadRing mUploadRing;
+    VkDescriptorSetLayout mFrameParamsSetLayout = VK_NULL_HANDLE;
+    VkDescriptorSet mFrameParamsDescriptorSet = VK_NULL_HANDLE;  // Dynamic offset selects the frame context
+
+    VkDescriptorSetLayout mDescriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool mDescriptorPool = VK_NULL_HANDLE;  // Sets that live as long as the simulation
+    // Indexed by sim state: compute set k reads state k and writes the next state in the ring,
+    // graphics set k renders state k interpolated from the one before it.
+    std::vector<VkDescriptorSet> mComputeDescriptorSets;
+    std::vector<VkDescriptorSet> mGraphicsDescriptorSets;
     std::vector<VkFramebuffer> mFramebuffers;
 
-    VkBuffer mVelocityBuffer;
-    VkDeviceMemory mVelocityBufferMemory;
+    // One solver state: velocity and pressure for every cell
+    struct SimState {
+        VkBuffer velocity = VK_NULL_HANDLE;
+        VkDeviceMemory velocityMemory = VK_NULL_HANDLE;
+        VkBuffer pressure = VK_NULL_HANDLE;
+        VkDeviceMemory pressureMemory = VK_NULL_HANDLE;
+        uint64_t lastRenderValue = 0;  // Last frame whose fragment pass reads this state
+    };
+
+    // Fixed-step simulation on a ring of 2 + sim_pipeline_depth states. Each solver step reads
+    // state k and writes state k + 1, so the solver can fill new states while the fragment pass
+    // still reads older ones. mSimState is the state holding the latest solver step.
+    SimScheduler mSimScheduler;
+    std::vector<SimState> mSimStates;
+    uint32_t mSimState = 0;
+    // With CFL substeps the state before the latest is only a substep old, but the fragment pass
+    // interpolates by a fraction of a whole step. The state at the start of a frame's last full
+    // step is kept here and copied over the one before the latest once the step is done.
+    SimState mStepSnapshot;
+    VkDeviceSize mGridCapacity = 0;  // Cells each state has room for: the grid plus grid_headroom percent
+
+    // A new surface size or orientation, carried over by resampleGrid(). The grid size is baked
+    // into the solver, so pipelines for the new grid build on the worker pool first while the old
+    // grid keeps running, stretched over the new surface.
+    struct GridResize {
+        bool pending = false;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t quarterTurns = 0;      // Clockwise, summed over every rotation since the last resample
+        bool pipelinesSubmitted = false;
+        ComputePipelineSet pipelines{};  // For the new grid; not needed if only the orientation changed
+    } mGridResize;
+    PendingPipeline mResamplePipeline;
+    VkPipelineLayout mResamplePipelineLayout = VK_NULL_HANDLE;
+    VkDescriptorSetLayout mResampleDescriptorSetLayout = VK_NULL_HANDLE;
+
+    // Timing of the mComputeUpgrade candidates, one per frame on the solver's queue ahead of that
+    // frame's own steps. Runs on scratch states and tile buffers with every tile listed, so the
+    // live field and tile map are never touched.
+    struct ComputeAutotune {
+        VkQueryPool queryPool = VK_NULL_HANDLE;  // Two timestamps per candidate
+        size_t submitted = 0;                    // Candidates timed so far
+        std::array<SimState, 2> states{};        // Each step reads one and writes the other
+        VkBuffer tileFlags = VK_NULL_HANDLE;
+        VkDeviceMemory tileFlagsMemory = VK_NULL_HANDLE;
+        VkBuffer tileList = VK_NULL_HANDLE;  // Every tile, written once by the host
+        VkDeviceMemory tileListMemory = VK_NULL_HANDLE;
+        VkBuffer tileArgs = VK_NULL_HANDLE;  // One VkDispatchIndirectCommand per candidate
+        VkDeviceMemory tileArgsMemory = VK_NULL_HANDLE;
+    } mAutotune;
+
+    uint32_t nextSimState(uint32_t state) const {
+        return (state + 1) % static_cast<uint32_t>(mSimStates.size());
+    }
+    uint32_t previousSimState(uint32_t state) const {
+        return (state + static_cast<uint32_t>(mSimStates.size()) - 1) % static_cast<uint32_t>(mSimStates.size());
+    }
+    void destroySimState(SimState& state);
+    void createComputeAutotune();
+    void submitAutotuneCandidate(FrameContext& frame, size_t candidate, uint64_t frameValue);
+    bool finishComputeAutotune(size_t& best);
+    void destroyComputeAutotune(ComputeAutotune& autotune);
+
+    // Render loop
+    struct TouchState {
+        float x = 0.0f;
+        float y = 0.0f;
+        bool isTouching = false;
+        std::vector<glm::vec2> samples;  // Touched positions since the last frame, oldest first
+    };
 
-    VkBuffer mPressureBuffer;
-    VkDeviceMemory mPressureBufferMemory;
+    std::thread mRenderThread;
+    std::mutex mRenderLoopMutex;
+    std::condition_variable mRenderLoopCv;
+    bool mRenderLoopRunning = false;
+    bool mRenderLoopPaused = false;
+    bool mSimIdle = false;  // Field has settled; sleep until the next touch
 
-    VkBuffer mVelocityOutputBuffer;
-    VkDeviceMemory mVelocityOutputBufferMemory;
+    std::mutex mTouchMutex;
+    TouchState mTouch;
 
-    VkBuffer mPressureOutputBuffer;
-    VkDeviceMemory mPressureOutputBufferMemory;
+    void renderLoop();
 
     // JNI
     JavaVM* mJvm;
     jobject mActivity;
 
+    std::string mFilesDir;  // App-private storage for fs20.conf, tuning.cache and pipeline.cache
+    EngineConfig mConfig;
+
 
     std::string decodeSurfaceTransformFlags(VkSurfaceTransformFlagsKHR flags);
 
@@ -185,7 +624,7 @@ private:
 
     std::string decodeUsageFlags(VkImageUsageFlags flags);
 
-    void notifyClient();
+    void notifyClient(float firstFrameMs, float readyMs);
 };
 
 #endif //FINGERSMOKE2_0_FS20_H
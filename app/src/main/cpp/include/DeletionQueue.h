@@ -0,0 +1,45 @@
+// DeletionQueue.h
+#ifndef DELETION_QUEUE_H
+#define DELETION_QUEUE_H
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <utility>
+
+// Destruction of GPU objects deferred until the GPU is done with them.
+//
+// push() takes the timeline value of the last frame that may use the objects and a function
+// destroying them; flush() runs, oldest first, every function whose frame the GPU has completed.
+// Frame values only grow, so entries are already in order and flush() stops at the first one
+// still in flight. flushAll() is for teardown, once the device is idle.
+class DeletionQueue {
+public:
+    void push(uint64_t lastUseValue, std::function<void()> destroy) {
+        mEntries.push_back({lastUseValue, std::move(destroy)});
+    }
+
+    void flush(uint64_t completedValue) {
+        while (!mEntries.empty() && mEntries.front().lastUseValue <= completedValue) {
+            std::function<void()> destroy = std::move(mEntries.front().destroy);
+            mEntries.pop_front();
+            destroy();
+        }
+    }
+
+    void flushAll() {
+        flush(UINT64_MAX);
+    }
+
+    bool empty() const { return mEntries.empty(); }
+
+private:
+    struct Entry {
+        uint64_t lastUseValue;
+        std::function<void()> destroy;
+    };
+
+    std::deque<Entry> mEntries;
+};
+
+#endif // DELETION_QUEUE_H
@@ -0,0 +1,74 @@
+// EmbeddedShaders.h
+#ifndef EMBEDDED_SHADERS_H
+#define EMBEDDED_SHADERS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+// SPIR-V for every shader and kernel permutation, compiled at build time by glslc -mfmt=num (see
+// compile_shader in CMakeLists.txt) and linked into the library as read-only data. Shader modules
+// are created straight from these arrays; nothing is read from disk.
+struct EmbeddedShader {
+    const char* name;      // compile_shader OUTPUT_NAME, e.g. "compute_shader_shared_fp16"
+    const uint32_t* code;
+    size_t size;           // In bytes, as VkShaderModuleCreateInfo::codeSize expects
+};
+
+namespace embedded_spirv {
+constexpr uint32_t vertex_shader[] = {
+#include "vertex_shader.spv.inc"
+};
+constexpr uint32_t fragment_shader[] = {
+#include "fragment_shader.spv.inc"
+};
+constexpr uint32_t tile_compact[] = {
+#include "tile_compact.spv.inc"
+};
+constexpr uint32_t compute_shader[] = {
+#include "compute_shader.spv.inc"
+};
+constexpr uint32_t compute_shader_shared[] = {
+#include "compute_shader_shared.spv.inc"
+};
+constexpr uint32_t compute_shader_shared_fp16[] = {
+#include "compute_shader_shared_fp16.spv.inc"
+};
+constexpr uint32_t field_reduce[] = {
+#include "field_reduce.spv.inc"
+};
+constexpr uint32_t field_reduce_subgroup[] = {
+#include "field_reduce_subgroup.spv.inc"
+};
+constexpr uint32_t resample[] = {
+#include "resample.spv.inc"
+};
+}  // namespace embedded_spirv
+
+#define EMBEDDED_SHADER(NAME) {#NAME, embedded_spirv::NAME, sizeof(embedded_spirv::NAME)}
+
+constexpr EmbeddedShader kEmbeddedShaders[] = {
+        EMBEDDED_SHADER(vertex_shader),
+        EMBEDDED_SHADER(fragment_shader),
+        EMBEDDED_SHADER(tile_compact),
+        EMBEDDED_SHADER(compute_shader),
+        EMBEDDED_SHADER(compute_shader_shared),
+        EMBEDDED_SHADER(compute_shader_shared_fp16),
+        EMBEDDED_SHADER(field_reduce),
+        EMBEDDED_SHADER(field_reduce_subgroup),
+        EMBEDDED_SHADER(resample),
+};
+
+#undef EMBEDDED_SHADER
+
+// Returns nullptr for a name that wasn't compiled in
+inline const EmbeddedShader* findEmbeddedShader(const char* name) {
+    for (const auto& shader : kEmbeddedShaders) {
+        if (std::strcmp(shader.name, name) == 0) {
+            return &shader;
+        }
+    }
+    return nullptr;
+}
+
+#endif // EMBEDDED_SHADERS_H
@@ -0,0 +1,63 @@
+// EngineConfig.h
+#ifndef ENGINE_CONFIG_H
+#define ENGINE_CONFIG_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+
+// Optional engine settings, read once at startup from a key=value file in the app's files
+// directory. Lines starting with '#' are comments, unknown keys are ignored, and a missing file
+// or malformed value simply means the built-in default.
+class EngineConfig {
+public:
+    static EngineConfig load(const std::string& path) {
+        EngineConfig config;
+        std::ifstream file(path);
+        std::string line;
+        while (std::getline(file, line)) {
+            size_t separator = line.find('=');
+            if (line.empty() || line[0] == '#' || separator == std::string::npos) {
+                continue;
+            }
+            config.mValues[trim(line.substr(0, separator))] = trim(line.substr(separator + 1));
+        }
+        return config;
+    }
+
+    std::string getString(const std::string& key, const std::string& fallback) const {
+        auto it = mValues.find(key);
+        return it != mValues.end() ? it->second : fallback;
+    }
+
+    bool getBool(const std::string& key, bool fallback) const {
+        auto it = mValues.find(key);
+        if (it == mValues.end()) {
+            return fallback;
+        }
+        return it->second == "1" || it->second == "true" || it->second == "yes" || it->second == "on";
+    }
+
+    uint32_t getUint(const std::string& key, uint32_t fallback) const {
+        auto it = mValues.find(key);
+        if (it == mValues.end()) {
+            return fallback;
+        }
+        std::istringstream stream(it->second);
+        uint32_t value;
+        return (stream >> value) ? value : fallback;
+    }
+
+private:
+    std::map<std::string, std::string> mValues;
+
+    static std::string trim(const std::string& s) {
+        size_t first = s.find_first_not_of(" \t\r");
+        size_t last = s.find_last_not_of(" \t\r");
+        return first == std::string::npos ? std::string() : s.substr(first, last - first + 1);
+    }
+};
+
+#endif // ENGINE_CONFIG_H
@@ -0,0 +1,242 @@
+// FrameGraph.h
+#ifndef FRAME_GRAPH_H
+#define FRAME_GRAPH_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Passes recorded into one command buffer, with the synchronization between them derived from
+// what each declares it reads and writes.
+//
+// Passes are added in recording order. compile() culls passes that write nothing and have no side
+// effects, then works out the barrier each remaining pass needs against the passes before it.
+// execute() records the passes, each preceded by at most one global memory barrier covering all
+// its hazards. Only buffers are tracked; images are written by render passes, whose subpass
+// dependencies already handle layout transitions.
+//
+// Every resource is imported; there are no graph-owned transients to alias. Each buffer the engine
+// records a graph over either outlives the graph (the sim states, including resampleGrid()'s
+// target) or is used from the graph's first pass to its last (the autotuning scratch), so placing
+// them in shared memory would not lower peak memory.
+//
+// The barriers are synchronization2 structures, but every stage and access flag the engine uses
+// has the same value in the legacy enums, so the BarrierFn may also record them with
+// vkCmdPipelineBarrier.
+class FrameGraph {
+public:
+    using ResourceId = uint32_t;
+    using RecordFn = std::function<void(VkCommandBuffer)>;
+    using BarrierFn = std::function<void(VkCommandBuffer, const VkMemoryBarrier2KHR&)>;
+
+    struct Access {
+        VkPipelineStageFlags2KHR stages = 0;
+        VkAccessFlags2KHR access = 0;
+    };
+
+    class PassBuilder {
+    public:
+        PassBuilder& reads(ResourceId resource, VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access) {
+            mGraph.mPasses[mPass].uses.push_back({resource, {stages, access}, false});
+            return *this;
+        }
+        PassBuilder& writes(ResourceId resource, VkPipelineStageFlags2KHR stages, VkAccessFlags2KHR access) {
+            mGraph.mPasses[mPass].uses.push_back({resource, {stages, access}, true});
+            return *this;
+        }
+        // Never culled, e.g. a pass drawing to the swapchain, which the graph doesn't track
+        PassBuilder& hasSideEffects() {
+            mGraph.mPasses[mPass].sideEffects = true;
+            return *this;
+        }
+
+    private:
+        friend class FrameGraph;
+        PassBuilder(FrameGraph& graph, uint32_t pass) : mGraph(graph), mPass(pass) {}
+        FrameGraph& mGraph;
+        uint32_t mPass;
+    };
+
+    // A buffer that outlives the graph; passes writing it are never culled. `prior` is what the
+    // queue may still be doing to it from before this graph, which its first use waits for.
+    ResourceId importBuffer(std::string name, Access prior) {
+        Resource resource;
+        resource.name = std::move(name);
+        resource.prior = prior;
+        mResources.push_back(std::move(resource));
+        return static_cast<ResourceId>(mResources.size() - 1);
+    }
+
+    // How the resource is used after the graph, e.g. host reads of a readback buffer. The graph
+    // ends with a barrier making its writes available there.
+    void exportResource(ResourceId resource, Access next) {
+        mResources[resource].exported = next;
+    }
+
+    PassBuilder addPass(std::string name, RecordFn record) {
+        Pass pass;
+        pass.name = std::move(name);
+        pass.record = std::move(record);
+        mPasses.push_back(std::move(pass));
+        return PassBuilder(*this, static_cast<uint32_t>(mPasses.size() - 1));
+    }
+
+    void compile() {
+        cullPasses();
+        computeBarriers();
+        mCompiled = true;
+    }
+
+    void execute(VkCommandBuffer commandBuffer, const BarrierFn& barrier) const {
+        if (!mCompiled) {
+            throw std::runtime_error("FrameGraph executed before compile()");
+        }
+        for (const Pass& pass : mPasses) {
+            if (pass.culled) {
+                continue;
+            }
+            if (pass.barrier.srcStageMask != 0) {
+                barrier(commandBuffer, pass.barrier);
+            }
+            pass.record(commandBuffer);
+        }
+        if (mFinalBarrier.srcStageMask != 0) {
+            barrier(commandBuffer, mFinalBarrier);
+        }
+    }
+
+private:
+    struct Use {
+        ResourceId resource;
+        Access access;
+        bool write;
+    };
+
+    struct Pass {
+        std::string name;
+        RecordFn record;
+        std::vector<Use> uses;
+        bool sideEffects = false;
+        bool culled = false;
+        VkMemoryBarrier2KHR barrier{};  // Recorded before the pass when srcStageMask is set
+    };
+
+    // Where the GPU stands with a resource while the barriers are being worked out
+    struct SyncState {
+        Access lastWrite;                          // Writes not yet known to be finished
+        VkPipelineStageFlags2KHR visibleStages = 0;  // Where lastWrite has been made visible
+        VkAccessFlags2KHR visibleAccess = 0;
+        VkPipelineStageFlags2KHR readStages = 0;     // Reads since lastWrite
+        VkPipelineStageFlags2KHR orderedStages = 0;  // Stages already ordered after readStages
+    };
+
+    struct Resource {
+        std::string name;
+        Access prior;
+        Access exported;
+        SyncState sync;
+    };
+
+    // Every resource outlives the graph, so any write is needed
+    void cullPasses() {
+        for (Pass& pass : mPasses) {
+            bool keep = pass.sideEffects;
+            for (const Use& use : pass.uses) {
+                keep = keep || use.write;
+            }
+            pass.culled = !keep;
+        }
+    }
+
+    // Adds to `barrier` whatever `use` needs against the resource's state before the pass
+    static void addHazards(const SyncState& sync, const Use& use, VkMemoryBarrier2KHR& barrier) {
+        const Access& access = use.access;
+        if (sync.lastWrite.stages != 0) {
+            bool visible = (access.stages & ~sync.visibleStages) == 0 && (access.access & ~sync.visibleAccess) == 0;
+            if (!visible) {  // Read after write, or write after write
+                barrier.srcStageMask |= sync.lastWrite.stages;
+                barrier.srcAccessMask |= sync.lastWrite.access;
+                barrier.dstStageMask |= access.stages;
+                barrier.dstAccessMask |= access.access;
+            }
+        }
+        if (use.write && sync.readStages != 0 && (access.stages & ~sync.orderedStages) != 0) {
+            barrier.srcStageMask |= sync.readStages;  // Write after read: execution only
+            barrier.dstStageMask |= access.stages;
+        }
+    }
+
+    void computeBarriers() {
+        for (Resource& resource : mResources) {
+            resource.sync = SyncState{};
+            resource.sync.lastWrite = resource.prior;
+            resource.sync.readStages = resource.prior.stages;
+        }
+
+        for (uint32_t p = 0; p < mPasses.size(); ++p) {
+            Pass& pass = mPasses[p];
+            pass.barrier = VkMemoryBarrier2KHR{};
+            pass.barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+            if (pass.culled) {
+                continue;
+            }
+
+            for (const Use& use : pass.uses) {
+                addHazards(mResources[use.resource].sync, use, pass.barrier);
+            }
+            if (pass.barrier.srcStageMask != 0) {
+                applyBarrier(pass.barrier);
+            }
+
+            // The pass's own accesses, once its barrier has been applied
+            for (const Use& use : pass.uses) {
+                SyncState& sync = mResources[use.resource].sync;
+                if (use.write) {
+                    sync = SyncState{};
+                    sync.lastWrite = use.access;
+                }
+            }
+            for (const Use& use : pass.uses) {
+                SyncState& sync = mResources[use.resource].sync;
+                if (!use.write) {
+                    sync.readStages |= use.access.stages;
+                    sync.orderedStages = 0;
+                }
+            }
+        }
+
+        mFinalBarrier = VkMemoryBarrier2KHR{};
+        mFinalBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2_KHR;
+        for (ResourceId id = 0; id < mResources.size(); ++id) {
+            const Resource& resource = mResources[id];
+            if (resource.exported.stages != 0) {
+                addHazards(resource.sync, {id, resource.exported, false}, mFinalBarrier);
+            }
+        }
+    }
+
+    // A global barrier covers every resource, not just the ones that asked for it
+    void applyBarrier(const VkMemoryBarrier2KHR& barrier) {
+        for (Resource& resource : mResources) {
+            SyncState& sync = resource.sync;
+            if ((sync.lastWrite.stages & ~barrier.srcStageMask) == 0 && (sync.lastWrite.access & ~barrier.srcAccessMask) == 0) {
+                sync.visibleStages |= barrier.dstStageMask;
+                sync.visibleAccess |= barrier.dstAccessMask;
+            }
+            if ((sync.readStages & ~barrier.srcStageMask) == 0) {
+                sync.orderedStages |= barrier.dstStageMask;
+            }
+        }
+    }
+
+    std::vector<Resource> mResources;
+    std::vector<Pass> mPasses;
+    VkMemoryBarrier2KHR mFinalBarrier{};
+    bool mCompiled = false;
+};
+
+#endif // FRAME_GRAPH_H
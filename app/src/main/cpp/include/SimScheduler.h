@@ -0,0 +1,63 @@
+// SimScheduler.h
+#ifndef SIM_SCHEDULER_H
+#define SIM_SCHEDULER_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Fixed-timestep accumulator for the fluid solver.
+//
+// The render loop calls advance() once per displayed frame with the measured frame time and runs
+// the returned number of solver steps, each stepSize() long. Whatever is left over is exposed as
+// alpha() in [0, 1) so the renderer can interpolate between the last two simulation states, which
+// lets a 90/120 Hz display present smoothly while the solver stays at a fixed (cheaper) rate.
+class SimScheduler {
+public:
+    explicit SimScheduler(float stepSize = 1.0f / 60.0f, uint32_t maxStepsPerFrame = 4,
+                          float courant = 0.9f, uint32_t maxCflSubsteps = 8)
+            : mStepSize(stepSize), mMaxStepsPerFrame(maxStepsPerFrame),
+              mCourant(courant), mMaxCflSubsteps(maxCflSubsteps) {}
+
+    // Returns how many solver steps to run for a frame that took frameDelta seconds.
+    // At most mMaxStepsPerFrame steps are returned; any backlog beyond that is dropped so a slow
+    // frame can't snowball into ever more steps per frame (the "spiral of death").
+    uint32_t advance(float frameDelta) {
+        mAccumulator += std::max(frameDelta, 0.0f);
+
+        auto steps = static_cast<uint32_t>(mAccumulator / mStepSize);
+        if (steps > mMaxStepsPerFrame) {
+            steps = mMaxStepsPerFrame;
+            mAccumulator = static_cast<float>(steps) * mStepSize;
+        }
+        mAccumulator -= static_cast<float>(steps) * mStepSize;
+        return steps;
+    }
+
+    // How many equal substeps one step must be split into so that, at the given peak speed
+    // (grid cells per second), nothing travels further than the Courant number of cells per
+    // substep. Calm flow runs each step as one large substep; violent flow as several small ones.
+    uint32_t cflSubsteps(float maxSpeed) const {
+        float cellsPerStep = maxSpeed * mStepSize / mCourant;
+        if (!(cellsPerStep > 1.0f)) {
+            return 1;  // Also catches NaN from a blown-up field
+        }
+        auto substeps = static_cast<uint32_t>(std::ceil(std::min(cellsPerStep, static_cast<float>(mMaxCflSubsteps))));
+        return std::min(substeps, mMaxCflSubsteps);
+    }
+
+    float alpha() const { return std::min(mAccumulator / mStepSize, 1.0f); }
+    float stepSize() const { return mStepSize; }
+    uint32_t maxStepsPerFrame() const { return mMaxStepsPerFrame; }
+
+    void reset() { mAccumulator = 0.0f; }
+
+private:
+    float mStepSize;
+    uint32_t mMaxStepsPerFrame;
+    float mCourant;
+    uint32_t mMaxCflSubsteps;
+    float mAccumulator = 0.0f;
+};
+
+#endif // SIM_SCHEDULER_H
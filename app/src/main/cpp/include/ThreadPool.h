@@ -0,0 +1,83 @@
+// ThreadPool.h
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed set of worker threads running submitted tasks in FIFO order.
+//
+// submit() returns a future for the task's result; an exception thrown by the task is stored in
+// the future and rethrown by get(). The destructor finishes every queued task before joining, so
+// futures handed out earlier never end up broken.
+class ThreadPool {
+public:
+    explicit ThreadPool(unsigned threadCount) {
+        if (threadCount == 0) {
+            threadCount = 1;
+        }
+        for (unsigned i = 0; i < threadCount; ++i) {
+            mWorkers.emplace_back([this] { workerLoop(); });
+        }
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mStopping = true;
+        }
+        mCv.notify_all();
+        for (auto& worker : mWorkers) {
+            worker.join();
+        }
+    }
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    template <typename F>
+    auto submit(F task) -> std::future<decltype(task())> {
+        using Result = decltype(task());
+        auto packaged = std::make_shared<std::packaged_task<Result()>>(std::move(task));
+        std::future<Result> result = packaged->get_future();
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mTasks.emplace_back([packaged] { (*packaged)(); });
+        }
+        mCv.notify_one();
+        return result;
+    }
+
+    size_t size() const { return mWorkers.size(); }
+
+private:
+    void workerLoop() {
+        for (;;) {
+            std::function<void()> task;
+            {
+                std::unique_lock<std::mutex> lock(mMutex);
+                mCv.wait(lock, [this] { return mStopping || !mTasks.empty(); });
+                if (mTasks.empty()) {
+                    return;  // Stopping and drained
+                }
+                task = std::move(mTasks.front());
+                mTasks.pop_front();
+            }
+            task();
+        }
+    }
+
+    std::vector<std::thread> mWorkers;
+    std::deque<std::function<void()>> mTasks;
+    std::mutex mMutex;
+    std::condition_variable mCv;
+    bool mStopping = false;
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,65 @@
+// TuningCache.h
+#ifndef TUNING_CACHE_H
+#define TUNING_CACHE_H
+
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Persists the results of expensive startup measurements (autotuning, benchmarks) across
+// launches. One entry per line, "key value value ...". Keys should include whatever invalidates
+// the result, e.g. the GPU's vendor/device IDs and driver version.
+class TuningCache {
+public:
+    explicit TuningCache(std::string path) : mPath(std::move(path)) {
+        std::ifstream file(mPath);
+        std::string line;
+        while (std::getline(file, line)) {
+            std::istringstream stream(line);
+            std::string key;
+            if (!(stream >> key)) {
+                continue;
+            }
+            std::vector<uint32_t> values;
+            uint32_t value;
+            while (stream >> value) {
+                values.push_back(value);
+            }
+            mEntries[key] = values;
+        }
+    }
+
+    bool lookup(const std::string& key, std::vector<uint32_t>& values) const {
+        auto it = mEntries.find(key);
+        if (it == mEntries.end()) {
+            return false;
+        }
+        values = it->second;
+        return true;
+    }
+
+    // Rewrites the whole file; returns false if it couldn't be written (the entry is still
+    // remembered for this run).
+    bool store(const std::string& key, const std::vector<uint32_t>& values) {
+        mEntries[key] = values;
+
+        std::ofstream file(mPath, std::ios::trunc);
+        for (const auto& entry : mEntries) {
+            file << entry.first;
+            for (uint32_t value : entry.second) {
+                file << ' ' << value;
+            }
+            file << '\n';
+        }
+        return static_cast<bool>(file);
+    }
+
+private:
+    std::string mPath;
+    std::map<std::string, std::vector<uint32_t>> mEntries;
+};
+
+#endif // TUNING_CACHE_H
@@ -0,0 +1,73 @@
+// UploadRing.h
+#ifndef UPLOAD_RING_H
+#define UPLOAD_RING_H
+
+#include <cstdint>
+#include <deque>
+
+// Bump allocator over a fixed-size ring of bytes shared by every frame in flight.
+//
+// Allocations follow one another round the ring. endFrame() marks where a frame's allocations
+// end, tagged with the frame's timeline value; release() hands the space up to a mark back once
+// the GPU has passed that value. An allocation that would straddle the end of the ring starts
+// over at offset 0 instead, and one that would run into space still in use fails, so the caller
+// can wait for oldestPendingFrame() and retry. Positions only ever grow; offsets are positions
+// modulo the ring size, which must be a multiple of every alignment asked for.
+class UploadRing {
+public:
+    explicit UploadRing(uint64_t size = 0) : mSize(size) {}
+
+    void reset(uint64_t size) {
+        mSize = size;
+        mHead = 0;
+        mTail = 0;
+        mMarks.clear();
+    }
+
+    // Returns false if the ring can't fit `size` bytes until more frames are released
+    bool allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+        uint64_t start = alignUp(mHead, alignment);
+        if (start % mSize + size > mSize) {
+            start = alignUp(start, mSize);  // Start the next lap rather than wrap mid-allocation
+        }
+        if (start + size - mTail > mSize) {
+            return false;
+        }
+        mHead = start + size;
+        offset = start % mSize;
+        return true;
+    }
+
+    void endFrame(uint64_t frameValue) {
+        mMarks.push_back({frameValue, mHead});
+    }
+
+    // Every frame up to and including completedValue is done with its allocations
+    void release(uint64_t completedValue) {
+        while (!mMarks.empty() && mMarks.front().frameValue <= completedValue) {
+            mTail = mMarks.front().end;
+            mMarks.pop_front();
+        }
+    }
+
+    bool hasPendingFrames() const { return !mMarks.empty(); }
+    uint64_t oldestPendingFrame() const { return mMarks.front().frameValue; }
+    uint64_t size() const { return mSize; }
+
+private:
+    struct FrameMark {
+        uint64_t frameValue;
+        uint64_t end;  // Head position once the frame was done allocating
+    };
+
+    static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+        return (value + alignment - 1) / alignment * alignment;
+    }
+
+    uint64_t mSize;
+    uint64_t mHead = 0;
+    uint64_t mTail = 0;
+    std::deque<FrameMark> mMarks;
+};
+
+#endif // UPLOAD_RING_H
@@ -2,7 +2,6 @@ package com.aniviza.fingersmoke20;
 
 import android.app.Activity;
 import android.os.Bundle;
-import android.os.Handler;
 import android.view.MotionEvent;
 import android.view.Surface;
 import android.view.SurfaceHolder;
@@ -17,25 +16,8 @@ public class MainActivity extends Activity {
         System.loadLibrary("fingersmoke20");
     }
 
-    private long lastFrameTime = System.nanoTime();
-    private Thread renderThread;
-    private volatile boolean running = false;
-    private volatile float lastTouchX = 0;
-    private volatile float lastTouchY = 0;
-    private volatile boolean isTouching = false;
     private volatile boolean isInitialized;
-
-    private void updateTouch(float x, float y, boolean touching) {
-        this.lastTouchX = x;
-        this.lastTouchY = y;
-        this.isTouching = touching;
-    }
-    private float deltaTime() {
-        long currentTime = System.nanoTime();
-        float deltaTime = (currentTime - lastFrameTime) / 1_000_000_000.0f;
-        lastFrameTime = currentTime;
-        return deltaTime;
-    }
+    private volatile boolean isResumed;
 
     public void log(String msg) {
         Log.i("VulkanActivity",msg);
@@ -57,16 +39,10 @@ public class MainActivity extends Activity {
         surfaceView.getHolder().addCallback(new SurfaceHolder.Callback() {
             @Override
             public void surfaceCreated(SurfaceHolder holder) {
-                // The Surface is "ready" for rendering
-                new Handler().postDelayed(new Runnable() {
-                    @Override
-                    public void run() {
-                        initVulkan(holder.getSurface());
-                        isInitialized = true;
-                        log("surface created, initializing VulkanManager");
-                        //startRenderLoop();
-                    }
-                }, 5000); // delay for 500 milliseconds
+                // Init runs on a native thread and presents its first frame as soon as the swapchain exists.
+                // If the native side outlived an earlier surface it only attaches to this one.
+                log("surface created, initializing VulkanManager");
+                initVulkan(holder.getSurface(), getFilesDir().getAbsolutePath());
             }
 
             @Override
@@ -76,8 +52,9 @@ public class MainActivity extends Activity {
 
             @Override
             public void surfaceDestroyed(SurfaceHolder holder) {
-                // Cleanup Vulkan resources
-                cleanup();
+                // Only the swapchain goes; the device and the simulation stay for the next surface
+                isInitialized = false;
+                releaseSurface();
             }
         });
         // Set touch listener to capture touch events
@@ -103,79 +80,41 @@ public class MainActivity extends Activity {
     @Override
     protected void onResume() {
         super.onResume();
+        isResumed = true;
         if (isInitialized)
-            startRenderLoop();
+            resumeRenderLoop();
     }
 
     @Override
     protected void onPause() {
         super.onPause();
-        stopRenderLoop();
+        isResumed = false;
+        if (isInitialized)
+            pauseRenderLoop();
     }
 
     @Override
-    protected void onStop() {
-        super.onStop();
-        cleanup();
+    protected void onDestroy() {
+        super.onDestroy();
+        // A configuration change (e.g. rotation) brings a new activity and surface right back
+        if (!isChangingConfigurations())
+            cleanup();
     }
 
-    private void startRenderLoop() {
-        log("Starting render loop");
-        running = true;
-        renderThread = new Thread(() -> {
-            long lastTime = System.nanoTime();
-            final double ns = 1000000000.0 / 60.0;  // 60 frames per second
-            double delta = 0;
-
-            while (running) {
-                long now = System.nanoTime();
-                delta += (now - lastTime);// / ns;
-                lastTime = now;
-
-                while (delta/ns >= 1.0) {
-                    log("<Frame>");
-                    doDrawFrame((float)delta);  // Pass fixed delta time
-                    delta -= 1.0;
-                }
-
-                try {
-                    Thread.sleep(8);  // Sleep a little to yield time to the system
-                } catch (InterruptedException e) {
-
-                }
-            }
-        });
-        renderThread.start();
-    }
-
-    private void stopRenderLoop() {
-        running = false;
-        try {
-            renderThread.join();
-        } catch (InterruptedException e) {
-            Thread.currentThread().interrupt();
-        }
-    }
-
-    private void doDrawFrame(float delta) {
-        float x, y;
-        boolean touching;
-
-        // Copy the values to local variables to minimize the synchronization time.
-        synchronized (this) {
-            x = lastTouchX;
-            y = lastTouchY;
-            touching = isTouching;
-        }
-
-        log("doDrawFrame: "+delta+" x:"+x+" y:"+y);
-
-        // Pass the copied values to the native rendering method.
-        drawFrame(delta, x, y, touching);
+    // Called from the native init thread once the simulation is set up; the native render loop starts
+    // right after. Times are from the start of native init.
+    private void onVulkanReady(float firstFrameMs, float readyMs) {
+        log("Vulkan initialized: first frame after " + firstFrameMs + " ms, simulation ready after " + readyMs + " ms");
+        isInitialized = true;
+        if (!isResumed)
+            pauseRenderLoop();
     }
 
-    private native void initVulkan(Surface surface);
+    private native void initVulkan(Surface surface, String filesDir);
+    private native void releaseSurface();
     private native void cleanup();
-    private native void drawFrame(float delta, float x, float y, boolean isTouching);
+    private native void updateTouch(float x, float y, boolean isTouching);
+    private native void pauseRenderLoop();
+    private native void resumeRenderLoop();
 
 }
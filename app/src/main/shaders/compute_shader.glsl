@@ -1,5 +1,36 @@
 #version 450
-layout (local_size_x = 16, local_size_y = 16) in;
+
+// Compile-time permutations, picked per device by VulkanManager's kernel permutation table:
+//   USE_FP16         stencil arithmetic in half precision (storage stays fp32)
+//   USE_SHARED_TILE  stage the tile plus a one-cell halo in shared memory before the stencil
+#ifdef USE_FP16
+#extension GL_EXT_shader_explicit_arithmetic_types_float16 : require
+#define real float16_t
+#define real2 f16vec2
+#else
+#define real float
+#define real2 vec2
+#endif
+
+// Everything below that shapes the kernel is a specialization constant, set by the host from
+// VulkanManager::ComputeSpecialization when the pipeline is built; the compiler folds the index
+// math and unrolls the coarsening loop. The defaults only exist to make the module valid.
+layout (local_size_x_id = 0, local_size_y_id = 1) in;
+layout (constant_id = 2) const uint GRID_WIDTH = 1;
+layout (constant_id = 3) const uint GRID_HEIGHT = 1;
+layout (constant_id = 4) const uint BOUNDARY_MODE = 0;  // 0: walls held at zero, 1: periodic
+layout (constant_id = 5) const uint UNROLL = 1;         // Cells per invocation along x
+layout (constant_id = 6) const uint QUIET_PASSES = 1;   // Passes a tile stays scheduled once it goes quiet
+
+// A tile is one workgroup's footprint: UNROLL cells wide per invocation
+const uint TILE_WIDTH = gl_WorkGroupSize.x * UNROLL;
+const uint TILE_HEIGHT = gl_WorkGroupSize.y;
+const uint TILES_X = (GRID_WIDTH + TILE_WIDTH - 1) / TILE_WIDTH;
+const uint HALO_WIDTH = TILE_WIDTH + 2;
+const uint HALO_HEIGHT = TILE_HEIGHT + 2;
+
+const uint BOUNDARY_ZERO = 0;
+const uint BOUNDARY_WRAP = 1;
 
 layout (binding = 0) buffer VelocityBuffer {
     vec2 velocities[]; // Vector field for velocities
@@ -13,55 +44,173 @@ layout (binding = 2) buffer VelocityOutput {
 layout (binding = 3) buffer PressureOutput {
     float outPressures[]; // Output buffer for updated pressures
 };
+layout (binding = 4) readonly buffer ActiveTiles {
+    uint activeTiles[]; // One workgroup per entry, compacted by tile_compact.glsl
+};
+layout (binding = 5) buffer TileFlags {
+    uint tileFlags[]; // Passes the tile stays scheduled for: QUIET_PASSES + 1 while it holds smoke, then counting down
+};
 
-layout (push_constant) uniform Params {
+// This frame's parameters, one slot per frame in flight on the host. Must match FrameParams
+// in fs20.h, tile_compact.glsl and fragment_shader.glsl.
+layout (set = 1, binding = 0) uniform FrameParams {
     float deltaTime;
     float visc;
+    uint splatOffset; // First touch splat in the upload ring
+    uint splatCount;  // Touch samples this frame, 0 when nobody is touching
+    float alpha;      // How far between the previous (0) and current (1) state this frame is
     int width;
     int height;
-    vec2 touchPos;  // Added touch position in normalized coordinates [0,1]
-    bool isTouching;  // Whether there is an active touch
 } params;
 
+// The host's per-frame upload ring; this frame's touch splats are params.splatCount positions in
+// normalized coordinates [0,1] starting at params.splatOffset
+layout (set = 1, binding = 1) readonly buffer Uploads {
+    vec2 splats[];
+};
+
+// A touch splat is cut off so it only reaches tiles tile_compact.glsl schedules for it
+#define TOUCH_RADIUS 0.05
+#define TOUCH_CUTOFF 0.15   // Must match TOUCH_CUTOFF in tile_compact.glsl
+// Touch force per second of simulated time, so splitting a step into CFL substeps doesn't change
+// how much a touch injects; 60 keeps the push of one default 1/60 s step
+#define TOUCH_STRENGTH 60.0
+
+// Below this a cell counts as empty, and a tile of empty cells drops out of the schedule
+const float ACTIVITY_EPSILON = 1e-4;
+
+shared uint tileActive;
+#ifdef USE_SHARED_TILE
+shared vec2 tileVelocities[HALO_WIDTH * HALO_HEIGHT];
+shared float tilePressures[HALO_WIDTH * HALO_HEIGHT];
+#endif
+uvec2 tileOrigin;
+
 // Helper function to compute index from 2D coordinates
 uint getIndex(uint x, uint y) {
-    return y * params.width + x;
+    return y * GRID_WIDTH + x;
 }
 
-// Main compute function
-void main() {
-    uint x = gl_GlobalInvocationID.x;
-    uint y = gl_GlobalInvocationID.y;
-    if (x >= params.width || y >= params.height) return;
+uint left(uint x) { return BOUNDARY_MODE == BOUNDARY_WRAP && x == 0 ? GRID_WIDTH - 1 : x - 1; }
+uint right(uint x) { return BOUNDARY_MODE == BOUNDARY_WRAP && x == GRID_WIDTH - 1 ? 0 : x + 1; }
+uint down(uint y) { return BOUNDARY_MODE == BOUNDARY_WRAP && y == 0 ? GRID_HEIGHT - 1 : y - 1; }
+uint up(uint y) { return BOUNDARY_MODE == BOUNDARY_WRAP && y == GRID_HEIGHT - 1 ? 0 : y + 1; }
+
+// Field values at a cell or its neighbour (offset components in -1..1), from the staged tile if
+// there is one, otherwise straight from the state buffers
+#ifdef USE_SHARED_TILE
+uint haloIndex(uvec2 cell, ivec2 offset) {
+    uvec2 local = uvec2(ivec2(cell - tileOrigin) + 1 + offset);
+    return local.y * HALO_WIDTH + local.x;
+}
+vec2 velocityAt(uvec2 cell, ivec2 offset) { return tileVelocities[haloIndex(cell, offset)]; }
+float pressureAt(uvec2 cell, ivec2 offset) { return tilePressures[haloIndex(cell, offset)]; }
+#else
+uint neighbourIndex(uvec2 cell, ivec2 offset) {
+    uint x = offset.x < 0 ? left(cell.x) : offset.x > 0 ? right(cell.x) : cell.x;
+    uint y = offset.y < 0 ? down(cell.y) : offset.y > 0 ? up(cell.y) : cell.y;
+    return getIndex(x, y);
+}
+vec2 velocityAt(uvec2 cell, ivec2 offset) { return velocities[neighbourIndex(cell, offset)]; }
+float pressureAt(uvec2 cell, ivec2 offset) { return pressures[neighbourIndex(cell, offset)]; }
+#endif
+
+#ifdef USE_SHARED_TILE
+// Every invocation of the workgroup helps load the tile and its halo. Halo cells off the grid
+// are only ever read by boundary cells, which don't read neighbours, so clamping is safe.
+void stageTile() {
+    for (uint i = gl_LocalInvocationIndex; i < HALO_WIDTH * HALO_HEIGHT; i += gl_WorkGroupSize.x * gl_WorkGroupSize.y) {
+        int hx = int(tileOrigin.x) + int(i % HALO_WIDTH) - 1;
+        int hy = int(tileOrigin.y) + int(i / HALO_WIDTH) - 1;
+        uint x, y;
+        if (BOUNDARY_MODE == BOUNDARY_WRAP) {
+            x = uint((hx + int(GRID_WIDTH)) % int(GRID_WIDTH));
+            y = uint((hy + int(GRID_HEIGHT)) % int(GRID_HEIGHT));
+        } else {
+            x = uint(clamp(hx, 0, int(GRID_WIDTH) - 1));
+            y = uint(clamp(hy, 0, int(GRID_HEIGHT) - 1));
+        }
+        tileVelocities[i] = velocities[getIndex(x, y)];
+        tilePressures[i] = pressures[getIndex(x, y)];
+    }
+}
+#endif
 
+// Updates one cell and returns whether it still holds smoke
+bool updateCell(uint x, uint y) {
     uint index = getIndex(x, y);
+    vec2 velocity = vec2(0.0);
+    float pressure = 0.0;
+
+    // With walls, the boundary cells stay at zero
+    if (BOUNDARY_MODE == BOUNDARY_WRAP || (x > 0 && y > 0 && x < GRID_WIDTH - 1 && y < GRID_HEIGHT - 1)) {
+        uvec2 cell = uvec2(x, y);
+
+        // Heat application based on touch, from every sample of the stroke this frame
+        vec2 position = vec2(x, y) / vec2(GRID_WIDTH, GRID_HEIGHT);
+        float touchEffect = 0.0;
+        for (uint i = 0; i < params.splatCount; ++i) {
+            float distanceToTouch = distance(position, splats[params.splatOffset + i]);
+            if (distanceToTouch < TOUCH_CUTOFF) {
+                touchEffect += exp(-(distanceToTouch * distanceToTouch) / (TOUCH_RADIUS * TOUCH_RADIUS));
+            }
+        }
+
+        // The cell's own velocity stays fp32 so small per-step increments aren't rounded away
+        vec2 centre = velocityAt(cell, ivec2(0, 0));
+        real2 l = real2(velocityAt(cell, ivec2(-1, 0)));
+        real2 r = real2(velocityAt(cell, ivec2(1, 0)));
+        real2 d = real2(velocityAt(cell, ivec2(0, -1)));
+        real2 u = real2(velocityAt(cell, ivec2(0, 1)));
 
-    // Handle boundaries
-    if (x == 0 || y == 0 || x == params.width - 1 || y == params.height - 1) {
-        outVelocities[index] = vec2(0.0);
-        outPressures[index] = 0.0;
-        return;
+        // Viscosity and heat application, both integrated over the substep
+        real2 laplacianV = l + r + d + u - real(4.0) * real2(centre);
+        velocity = centre + params.deltaTime * (params.visc * vec2(laplacianV) + TOUCH_STRENGTH * vec2(touchEffect));  // Applying heat effect as a force
+
+        // Pressure projection to maintain incompressibility
+        real divergence = (r.x - l.x + u.y - d.y) / real(2.0);
+        pressure = float((
+        real(pressureAt(cell, ivec2(-1, 0))) + real(pressureAt(cell, ivec2(1, 0))) +
+        real(pressureAt(cell, ivec2(0, -1))) + real(pressureAt(cell, ivec2(0, 1))) - divergence
+        ) / real(4.0));
     }
 
-    // Heat application based on touch
-    float distanceToTouch = distance(vec2(x, y) / vec2(params.width, params.height), params.touchPos);
-    float touchEffect = params.isTouching ? exp(-distanceToTouch * 10.0) : 0.0;
-
-    // Viscosity and heat application
-    vec2 laplacianV = vec2(
-    velocities[getIndex(x - 1, y)] + velocities[getIndex(x + 1, y)] +
-    velocities[getIndex(x, y - 1)] + velocities[getIndex(x, y + 1)] - 4.0 * velocities[index]
-    );
-    outVelocities[index] = velocities[index] + params.visc * params.deltaTime * laplacianV + vec2(touchEffect);  // Applying heat effect as a force
-
-    // Pressure projection to maintain incompressibility
-    float divergence = (
-    velocities[getIndex(x + 1, y)].x - velocities[getIndex(x - 1, y)].x +
-    velocities[getIndex(x, y + 1)].y - velocities[getIndex(x, y - 1)].y
-    ) / 2.0;
-    float pressure = (
-    pressures[getIndex(x - 1, y)] + pressures[getIndex(x + 1, y)] +
-    pressures[getIndex(x, y - 1)] + pressures[getIndex(x, y + 1)] - divergence
-    ) / 4.0;
+    outVelocities[index] = velocity;
     outPressures[index] = pressure;
+    return abs(velocity.x) + abs(velocity.y) + abs(pressure) > ACTIVITY_EPSILON;
+}
+
+// Main compute function
+void main() {
+    uint tile = activeTiles[gl_WorkGroupID.x];
+    tileOrigin = uvec2(tile % TILES_X, tile / TILES_X) * uvec2(TILE_WIDTH, TILE_HEIGHT);
+    uint y = tileOrigin.y + gl_LocalInvocationID.y;
+
+    if (gl_LocalInvocationIndex == 0) {
+        tileActive = 0;
+    }
+#ifdef USE_SHARED_TILE
+    stageTile();
+#endif
+    barrier();
+
+    // Thread coarsening: each invocation walks UNROLL cells, a workgroup width apart so
+    // neighbouring invocations still touch neighbouring cells
+    bool active = false;
+    for (uint i = 0; i < UNROLL; ++i) {
+        uint x = tileOrigin.x + i * gl_WorkGroupSize.x + gl_LocalInvocationID.x;
+        if (x < GRID_WIDTH && y < GRID_HEIGHT) {
+            active = updateCell(x, y) || active;
+        }
+    }
+    if (active) {
+        atomicOr(tileActive, 1u);
+    }
+    barrier();
+
+    // A tile that just went quiet stays scheduled for QUIET_PASSES more passes, one less than the
+    // states in the ring, so every state holds the settled field before it stops being updated.
+    if (gl_LocalInvocationIndex == 0) {
+        tileFlags[tile] = tileActive != 0u ? QUIET_PASSES + 1u : max(tileFlags[tile], 1u) - 1u;
+    }
 }
@@ -0,0 +1,121 @@
+#version 450
+
+// Compile-time permutation, picked per device by VulkanManager's kernel permutation table:
+//   USE_SUBGROUP_REDUCE  reduce within subgroups first; needs arithmetic subgroup ops and a
+//                        subgroup size of at least 16, so one subgroup can finish the job
+#ifdef USE_SUBGROUP_REDUCE
+#extension GL_KHR_shader_subgroup_arithmetic : require
+#endif
+
+layout (local_size_x = 256) in;
+
+// Same specialization constants as compute_shader.glsl, so tiles line up with solver workgroups
+layout (constant_id = 0) const uint SOLVER_LOCAL_SIZE_X = 1;
+layout (constant_id = 1) const uint SOLVER_LOCAL_SIZE_Y = 1;
+layout (constant_id = 2) const uint GRID_WIDTH = 1;
+layout (constant_id = 3) const uint GRID_HEIGHT = 1;
+layout (constant_id = 5) const uint UNROLL = 1;
+
+const uint TILE_WIDTH = SOLVER_LOCAL_SIZE_X * UNROLL;
+const uint TILE_HEIGHT = SOLVER_LOCAL_SIZE_Y;
+const uint TILES_X = (GRID_WIDTH + TILE_WIDTH - 1) / TILE_WIDTH;
+
+layout (binding = 0) readonly buffer VelocityBuffer {
+    vec2 velocities[]; // Latest solver state
+};
+
+// One slot per frame in flight; the host reads a slot back once that frame's fence has signaled.
+struct FieldStats {
+    uint maxSpeedBits;  // floatBitsToUint(max |u|); speeds are non-negative so uint order == float order
+    uint kineticEnergy; // sum of 0.5 |u|^2, fixed point
+    uint pressureMass;  // sum of |p|, fixed point
+};
+layout (binding = 1) buffer FieldStatsBuffer {
+    FieldStats stats[];
+};
+layout (binding = 2) readonly buffer PressureBuffer {
+    float pressures[]; // Latest solver state
+};
+layout (binding = 3) readonly buffer ActiveTiles {
+    uint activeTiles[]; // Tiles the last solver pass updated; everything else is settled
+};
+
+layout (push_constant) uniform Params {
+    uint slot;
+} params;
+
+// Sums are accumulated across workgroups with integer atomics. Capping each tile's contribution
+// below 2^16 can't overflow 32 bits for up to 65536 tiles (16M cells), beyond any phone screen.
+const float FIXED_POINT_SCALE = 1024.0;
+const float MAX_GROUP_CONTRIBUTION = 65535.0;
+
+shared float partialMax[256];
+shared float partialEnergy[256];
+shared float partialPressure[256];
+
+// Reduction of max |u|, kinetic energy and total |p| over the active tiles, dispatched indirectly
+// with one workgroup per tile: each workgroup reduces its tile in shared memory, then folds its
+// result into the slot with atomics. Tiles of any shape are walked 256 cells at a time.
+void main() {
+    uint lid = gl_LocalInvocationID.x;
+    uint tile = activeTiles[gl_WorkGroupID.x];
+    uint tileX = (tile % TILES_X) * TILE_WIDTH;
+    uint tileY = (tile / TILES_X) * TILE_HEIGHT;
+
+    float maxSpeed = 0.0;
+    float energy = 0.0;
+    float pressureMass = 0.0;
+    for (uint c = lid; c < TILE_WIDTH * TILE_HEIGHT; c += gl_WorkGroupSize.x) {
+        uint x = tileX + c % TILE_WIDTH;
+        uint y = tileY + c / TILE_WIDTH;
+        if (x < GRID_WIDTH && y < GRID_HEIGHT) {
+            uint i = y * GRID_WIDTH + x;
+            vec2 u = velocities[i];
+            maxSpeed = max(maxSpeed, length(u));
+            energy += 0.5 * dot(u, u);
+            pressureMass += abs(pressures[i]);
+        }
+    }
+#ifdef USE_SUBGROUP_REDUCE
+    // Each subgroup reduces in registers and leaves one partial; the first subgroup reduces those
+    maxSpeed = subgroupMax(maxSpeed);
+    energy = subgroupAdd(energy);
+    pressureMass = subgroupAdd(pressureMass);
+    if (subgroupElect()) {
+        partialMax[gl_SubgroupID] = maxSpeed;
+        partialEnergy[gl_SubgroupID] = energy;
+        partialPressure[gl_SubgroupID] = pressureMass;
+    }
+    barrier();
+
+    if (gl_SubgroupID == 0) {
+        bool hasPartial = gl_SubgroupInvocationID < gl_NumSubgroups;
+        maxSpeed = subgroupMax(hasPartial ? partialMax[gl_SubgroupInvocationID] : 0.0);
+        energy = subgroupAdd(hasPartial ? partialEnergy[gl_SubgroupInvocationID] : 0.0);
+        pressureMass = subgroupAdd(hasPartial ? partialPressure[gl_SubgroupInvocationID] : 0.0);
+    }
+#else
+    partialMax[lid] = maxSpeed;
+    partialEnergy[lid] = energy;
+    partialPressure[lid] = pressureMass;
+    barrier();
+
+    for (uint s = gl_WorkGroupSize.x / 2; s > 0; s >>= 1) {
+        if (lid < s) {
+            partialMax[lid] = max(partialMax[lid], partialMax[lid + s]);
+            partialEnergy[lid] += partialEnergy[lid + s];
+            partialPressure[lid] += partialPressure[lid + s];
+        }
+        barrier();
+    }
+    maxSpeed = partialMax[0];
+    energy = partialEnergy[0];
+    pressureMass = partialPressure[0];
+#endif
+
+    if (lid == 0) {
+        atomicMax(stats[params.slot].maxSpeedBits, floatBitsToUint(maxSpeed));
+        atomicAdd(stats[params.slot].kineticEnergy, uint(min(energy * FIXED_POINT_SCALE, MAX_GROUP_CONTRIBUTION)));
+        atomicAdd(stats[params.slot].pressureMass, uint(min(pressureMass * FIXED_POINT_SCALE, MAX_GROUP_CONTRIBUTION)));
+    }
+}
@@ -2,15 +2,46 @@
 layout(location = 0) in vec2 TexCoords; // Texture coordinates from vertex shader
 layout(location = 0) out vec4 FragColor; // Output fragment color
 
-layout(binding = 0) uniform sampler2D velocityTexture; // Texture containing velocity data
-layout(binding = 1) uniform sampler2D pressureTexture; // Texture containing pressure data
-layout(binding = 2) uniform sampler1D colorRampTexture; // Color ramp for mapping density to color
+// The last two solver states; the fragment shader interpolates between them.
+layout(binding = 0) readonly buffer PrevVelocityBuffer {
+    vec2 prevVelocities[];
+};
+layout(binding = 1) readonly buffer PrevPressureBuffer {
+    float prevPressures[];
+};
+layout(binding = 2) readonly buffer VelocityBuffer {
+    vec2 velocities[];
+};
+layout(binding = 3) readonly buffer PressureBuffer {
+    float pressures[];
+};
+
+// Must match FrameParams in compute_shader.glsl
+layout(set = 1, binding = 0) uniform FrameParams {
+    float deltaTime;
+    float visc;
+    uint splatOffset; // First touch splat in the upload ring
+    uint splatCount;  // Touch samples this frame, 0 when nobody is touching
+    float alpha;      // How far between the previous (0) and current (1) state this frame is
+    int width;
+    int height;
+} params;
+
+// Color ramp for mapping a [0,1] value to color
+vec4 colorRamp(float t) {
+    t = clamp(t, 0.0, 1.0);
+    return vec4(mix(vec3(0.0), vec3(0.85, 0.9, 1.0), t), 1.0);
+}
 
 void main() {
-    float velocity = length(texture(velocityTexture, TexCoords).rg); // Example: using magnitude of velocity
-    float pressure = texture(pressureTexture, TexCoords).r; // Direct sampling of pressure
-    vec4 velocityColor = texture(colorRampTexture, velocity); // Map velocity magnitude to color
-    vec4 pressureColor = texture(colorRampTexture, pressure); // Map pressure to color
+    ivec2 cell = min(ivec2(TexCoords * vec2(params.width, params.height)), ivec2(params.width - 1, params.height - 1));
+    int index = cell.y * params.width + cell.x;
+
+    vec2 velocityVec = mix(prevVelocities[index], velocities[index], params.alpha);
+    float pressure = mix(prevPressures[index], pressures[index], params.alpha);
+
+    vec4 velocityColor = colorRamp(length(velocityVec)); // Map velocity magnitude to color
+    vec4 pressureColor = colorRamp(pressure); // Map pressure to color
 
     // Combine or choose one of the color outputs
     FragColor = mix(velocityColor, pressureColor, 0.5); // Example: simple mix
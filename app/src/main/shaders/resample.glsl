@@ -0,0 +1,66 @@
+#version 450
+layout (local_size_x = 8, local_size_y = 8) in;
+
+// Carries one sim state over to a grid of another size or orientation: every cell of the new
+// grid samples the old one bilinearly at the same spot on the screen. Run once per resize, so
+// the grid sizes come in as push constants rather than specialization constants.
+layout (binding = 0) readonly buffer VelocityBuffer {
+    vec2 velocities[]; // Old grid
+};
+layout (binding = 1) readonly buffer PressureBuffer {
+    float pressures[]; // Old grid
+};
+layout (binding = 2) writeonly buffer VelocityOutput {
+    vec2 outVelocities[]; // New grid
+};
+layout (binding = 3) writeonly buffer PressureOutput {
+    float outPressures[]; // New grid
+};
+
+// Must match ResamplePushConstantData in fs20.h
+layout (push_constant) uniform Params {
+    ivec2 srcSize;
+    ivec2 dstSize;
+    uint quarterTurns; // Clockwise quarter turns of the content from the old grid to the new one
+} params;
+
+// One clockwise quarter turn on screen, where y points down
+vec2 quarterTurn(vec2 v, uint turns) {
+    for (uint i = 0; i < (turns & 3u); ++i) {
+        v = vec2(-v.y, v.x);
+    }
+    return v;
+}
+
+int srcIndex(ivec2 cell) {
+    cell = clamp(cell, ivec2(0), params.srcSize - 1);
+    return cell.y * params.srcSize.x + cell.x;
+}
+
+void main() {
+    ivec2 cell = ivec2(gl_GlobalInvocationID.xy);
+    if (cell.x >= params.dstSize.x || cell.y >= params.dstSize.y) {
+        return;
+    }
+
+    // Both grids cover the whole screen, so positions map through coordinates centred on it
+    vec2 centred = (vec2(cell) + 0.5) / vec2(params.dstSize) - 0.5;
+    vec2 source = (quarterTurn(centred, 4u - params.quarterTurns) + 0.5) * vec2(params.srcSize) - 0.5;
+
+    ivec2 base = ivec2(floor(source));
+    vec2 f = source - vec2(base);
+    int i00 = srcIndex(base);
+    int i10 = srcIndex(base + ivec2(1, 0));
+    int i01 = srcIndex(base + ivec2(0, 1));
+    int i11 = srcIndex(base + ivec2(1, 1));
+
+    vec2 velocity = mix(mix(velocities[i00], velocities[i10], f.x), mix(velocities[i01], velocities[i11], f.x), f.y);
+    float pressure = mix(mix(pressures[i00], pressures[i10], f.x), mix(pressures[i01], pressures[i11], f.x), f.y);
+
+    // Velocities are in cells per second: turn them with the content and rescale to the new cells
+    velocity = quarterTurn(velocity / vec2(params.srcSize), params.quarterTurns) * vec2(params.dstSize);
+
+    int index = cell.y * params.dstSize.x + cell.x;
+    outVelocities[index] = velocity;
+    outPressures[index] = pressure;
+}
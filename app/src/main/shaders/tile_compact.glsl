@@ -0,0 +1,85 @@
+#version 450
+layout (local_size_x = 64) in;
+
+// Same specialization constants as compute_shader.glsl, so tiles line up with solver workgroups
+layout (constant_id = 0) const uint SOLVER_LOCAL_SIZE_X = 1;
+layout (constant_id = 1) const uint SOLVER_LOCAL_SIZE_Y = 1;
+layout (constant_id = 2) const uint GRID_WIDTH = 1;
+layout (constant_id = 3) const uint GRID_HEIGHT = 1;
+layout (constant_id = 4) const uint BOUNDARY_MODE = 0;
+layout (constant_id = 5) const uint UNROLL = 1;
+
+const uint TILE_WIDTH = SOLVER_LOCAL_SIZE_X * UNROLL;
+const uint TILE_HEIGHT = SOLVER_LOCAL_SIZE_Y;
+const uint TILES_X = (GRID_WIDTH + TILE_WIDTH - 1) / TILE_WIDTH;
+const uint TILES_Y = (GRID_HEIGHT + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+const uint BOUNDARY_WRAP = 1;
+
+#define TOUCH_CUTOFF 0.15   // Must match TOUCH_CUTOFF in compute_shader.glsl
+
+layout (binding = 0) readonly buffer TileFlags {
+    uint tileFlags[]; // Written by the previous solver pass; nonzero = tile holds smoke or is settling
+};
+layout (binding = 1) writeonly buffer ActiveTiles {
+    uint activeTiles[]; // Compacted IDs of the tiles the next solver pass updates
+};
+layout (binding = 2) buffer DispatchArgs {
+    uint groupCountX; // Reset to 0 by the host before every pass; y and z stay 1
+    uint groupCountY;
+    uint groupCountZ;
+} args;
+
+// Must match FrameParams in compute_shader.glsl
+layout (set = 1, binding = 0) uniform FrameParams {
+    float deltaTime;
+    float visc;
+    uint splatOffset; // First touch splat in the upload ring
+    uint splatCount;  // Touch samples this frame, 0 when nobody is touching
+    float alpha;      // How far between the previous (0) and current (1) state this frame is
+    int width;
+    int height;
+} params;
+
+// The host's per-frame upload ring; this frame's touch splats are params.splatCount positions in
+// normalized coordinates [0,1] starting at params.splatOffset
+layout (set = 1, binding = 1) readonly buffer Uploads {
+    vec2 splats[];
+};
+
+// A tile is scheduled if it or any of its eight neighbours held smoke after the last pass (so
+// smoke can spread by one tile per pass), or if it lies within reach of a touch splat.
+void main() {
+    uint tile = gl_GlobalInvocationID.x;
+    if (tile >= TILES_X * TILES_Y) return;
+
+    ivec2 coord = ivec2(tile % TILES_X, tile / TILES_X);
+    ivec2 tiles = ivec2(TILES_X, TILES_Y);
+    bool active = false;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            ivec2 n = coord + ivec2(dx, dy);
+            if (BOUNDARY_MODE == BOUNDARY_WRAP) {
+                n = (n + tiles) % tiles;
+            }
+            if (n.x >= 0 && n.y >= 0 && n.x < tiles.x && n.y < tiles.y) {
+                active = active || tileFlags[n.y * tiles.x + n.x] != 0;
+            }
+        }
+    }
+
+    if (!active && params.splatCount != 0) {
+        vec2 size = vec2(GRID_WIDTH, GRID_HEIGHT);
+        vec2 tileSize = vec2(TILE_WIDTH, TILE_HEIGHT);
+        vec2 tileMin = vec2(coord) * tileSize / size;
+        vec2 tileMax = vec2(coord + 1) * tileSize / size;
+        for (uint i = 0; i < params.splatCount && !active; ++i) {
+            vec2 splat = splats[params.splatOffset + i];
+            active = distance(clamp(splat, tileMin, tileMax), splat) < TOUCH_CUTOFF;
+        }
+    }
+
+    if (active) {
+        activeTiles[atomicAdd(args.groupCountX, 1)] = tile;
+    }
+}